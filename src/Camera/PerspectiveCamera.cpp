@@ -79,7 +79,7 @@ void PerspectiveCamera::setSensorSize(const float width, const float height) {
 }
 
 void PerspectiveCamera::update() {
-    const bool wasDirty = scene.isAccumulationDirty();
+    const bool wasDirty = scene.isCameraDirty();
     const vec3 oldPosition = getPosition();
     const vec3 oldDirection = cameraData.direction;
 
@@ -133,10 +133,15 @@ void PerspectiveCamera::update() {
     const bool changed = wasDirty || !all(epsilonEqual(oldDirection, cameraData.direction, 0.001f)) || !all(epsilonEqual(oldPosition, getPosition(), 0.001f));
     if (changed) {
         updateHorizontalVertical();
-        scene.setAccumulationDirty();
+        scene.setCameraDirty();
     }
 }
 
+// Moving the camera only changes the view, so the accumulation may be reprojected
+void PerspectiveCamera::markTransformDirty() {
+    scene.setCameraDirty();
+}
+
 void PerspectiveCamera::renderUi() {
     SceneObject::renderUi();
 
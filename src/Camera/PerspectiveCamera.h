@@ -48,6 +48,9 @@ public:
     void setRotation(const quat& rot) override;
     void setRotationEuler(const vec3& rot) override;
 
+protected:
+    void markTransformDirty() override;
+
 private:
     void updateHorizontalVertical();
     void updateCameraData();
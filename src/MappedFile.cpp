@@ -0,0 +1,92 @@
+﻿#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Failed to query file size: " + path);
+    }
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    if (mappedSize == 0)
+        return;
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    mappedData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!mappedData) {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (mappedData)
+        UnmapViewOfFile(mappedData);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        throw std::runtime_error("Failed to open file: " + path);
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        close(fileDescriptor);
+        throw std::runtime_error("Failed to query file size: " + path);
+    }
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    if (mappedSize == 0)
+        return;
+
+    void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        close(fileDescriptor);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    // Parsers walk the file front to back.
+    madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+    mappedData = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (mappedData)
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+}
+
+#endif
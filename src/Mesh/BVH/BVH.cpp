@@ -1,60 +1,230 @@
 ﻿#include "BVH.h"
+#include "BVHCache.h"
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
 #include <limits>
 #include <numeric>
 #include <stack>
 
+#include "ThreadPool.h"
+
 #define GLM_ENABLE_EXPERIMENTAL
 
-#define BVH_MAX_DEPTH 128
+// Refit rebuilds once the SAH cost exceeds the freshly built cost by this factor
+#define BVH_REFIT_REBUILD_RATIO 1.5f
+
+// Bump whenever the builder changes in a way that alters its output, so stale cache entries are ignored
+#define BVH_BUILDER_VERSION 3
 
-// Surface Area Heuristic constants
-#define SAH_TRAVERSAL_COST 1.0f
-#define SAH_INTERSECTION_COST 1.0f
+uint64_t BVH::getBuilderKey(const BuildOptions& buildOptions) {
+    uint64_t key = BVH_BUILDER_VERSION;
+    for (const uint64_t value : {uint64_t(BVH_MAX_LEAF_SIZE), uint64_t(BVH_MAX_DEPTH), uint64_t(sizeof(BVHNode)),
+                                 uint64_t(SAH_TRAVERSAL_COST * 1000.0f), uint64_t(SAH_INTERSECTION_COST * 1000.0f),
+                                 uint64_t(buildOptions.builder), uint64_t(buildOptions.spatialSplitBudget * 1000.0f),
+                                 uint64_t(buildOptions.optimize)})
+        key = key * 0x100000001B3ull ^ value;
+    return key;
+}
 
-void BVH::build(const Context& context, const std::vector<Vertex>& inputVertices, const std::vector<uint32_t>& inputIndices) {
-    pVertices = &inputVertices;
+void BVH::build(const Context& context, const std::vector<vec3>& inputPositions, const std::vector<uint32_t>& inputIndices, const BuildOptions& buildOptions) {
+    pPositions = &inputPositions;
     pIndices = &inputIndices;
+    options = buildOptions;
+
+    buildNodes(true);
+    if (nodes.empty())
+        return;
+
+    buildTraversalNodes(context);
+}
+
+void BVH::buildTraversalNodes(const Context& context) {
+    buildWideNodes(buildRopes());
+    buildTriangles();
+    nodesBuffer = Buffer{context, Buffer::Type::AccelInput, sizeof(WideBVHNode) * wideNodes.size(), wideNodes.data()};
+    triangleBuffer = Buffer{context, Buffer::Type::AccelInput, sizeof(BVHTriangle) * triangles.size(), triangles.data()};
+    ropeBuffer = Buffer{context, Buffer::Type::AccelInput, sizeof(RopeBVHNode) * ropeNodes.size(), ropeNodes.data()};
+}
+
+void BVH::buildNodes(bool useCache) {
+    levelOffsets.clear();
+    levelNodes.clear();
+    wideNodes.clear();
+    wideSources.clear();
+    primitiveReferences.clear();
+    triangles.clear();
+    ropeNodes.clear();
+    ropeSources.clear();
+    optimizationReport = {};
 
     size_t faceCount = pIndices->size() / 3;
     if (faceCount == 0) {
         nodes.clear();
         return;
     }
-    
+
+    // Reuse a previous build of the same geometry if there is one.
+    // LBVH builds are cheaper than reading them back from disk, so they bypass the cache.
+    // Rebuilds triggered by refit skip the optimization to keep deforming meshes interactive.
+    const bool optimizeTree = options.optimize && useCache;
+    useCache = useCache && options.builder != Builder::LBVH;
+    uint64_t cacheKey = 0;
+    if (useCache) {
+        cacheKey = BVHCache::hashGeometry(*pPositions, *pIndices, getBuilderKey(options));
+        if (BVHCache::load(cacheKey, *pPositions, *pIndices, options.builder == Builder::SBVH, nodes)) {
+            builtSahCost = computeSahCost();
+            return;
+        }
+    }
+
     // Pre-allocate to avoid reallocations
     nodes.clear();
     nodes.reserve(faceCount * 2);
     
     // Build primitive info with better memory layout
-    std::vector<PrimitiveInfo> primitiveInfo;
-    primitiveInfo.reserve(faceCount);
-    
+    std::vector<PrimitiveInfo> primitiveInfo(faceCount);
+    std::mutex boundsMutex;
     AABB sceneBounds;
-    for (size_t i = 0; i < faceCount; ++i) {
-        PrimitiveInfo info;
-        info.faceIndex = static_cast<int>(i);
-        
-        const vec3& v0 = (*pVertices)[(*pIndices)[i * 3 + 0]].position;
-        const vec3& v1 = (*pVertices)[(*pIndices)[i * 3 + 1]].position;
-        const vec3& v2 = (*pVertices)[(*pIndices)[i * 3 + 2]].position;
-        
-        info.centroid = (v0 + v1 + v2) * (1.0f / 3.0f);
-        info.bbox.expand(v0);
-        info.bbox.expand(v1);
-        info.bbox.expand(v2);
-        
-        sceneBounds.expand(info.bbox);
-        primitiveInfo.push_back(info);
-    }
+    ThreadPool::get().parallelFor(faceCount, 1 << 14, [&](size_t begin, size_t end) {
+        AABB rangeBounds;
+        for (size_t i = begin; i < end; ++i) {
+            PrimitiveInfo& info = primitiveInfo[i];
+            info.faceIndex = static_cast<int>(i);
+
+            const vec3& v0 = (*pPositions)[(*pIndices)[i * 3 + 0]];
+            const vec3& v1 = (*pPositions)[(*pIndices)[i * 3 + 1]];
+            const vec3& v2 = (*pPositions)[(*pIndices)[i * 3 + 2]];
+
+            info.centroid = (v0 + v1 + v2) * (1.0f / 3.0f);
+            info.bbox = AABB();
+            info.bbox.expand(v0);
+            info.bbox.expand(v1);
+            info.bbox.expand(v2);
+
+            rangeBounds.expand(info.bbox);
+        }
+        std::lock_guard lock(boundsMutex);
+        sceneBounds.expand(rangeBounds);
+    });
 
     // Use iterative build to avoid stack overflow and improve cache locality
-    buildIterative(primitiveInfo, sceneBounds);
+    if (options.builder == Builder::SBVH)
+        buildSpatialSplits(primitiveInfo, sceneBounds);
+    else if (options.builder == Builder::LBVH)
+        buildLinear(primitiveInfo);
+    else
+        buildIterative(primitiveInfo, sceneBounds);
     
     if (nodes.empty())
         throw std::runtime_error("BVH build resulted in no nodes.");
 
-    nodesBuffer = Buffer{context, Buffer::Type::AccelInput, sizeof(BVHNode) * nodes.size(), nodes.data()};
+    if (optimizeTree)
+        optimize();
+
+    builtSahCost = computeSahCost();
+    if (useCache)
+        BVHCache::store(cacheKey, faceCount, nodes);
+}
+
+void BVH::buildLevels() {
+    levelOffsets.clear();
+    levelNodes.clear();
+    if (nodes.empty())
+        return;
+
+    // Breadth first, so every level only depends on the one below it
+    levelNodes.reserve(nodes.size());
+    levelNodes.push_back(0);
+    size_t levelStart = 0;
+    while (levelStart < levelNodes.size()) {
+        const size_t levelEnd = levelNodes.size();
+        levelOffsets.push_back(levelStart);
+        for (size_t i = levelStart; i < levelEnd; ++i) {
+            const BVHNode& node = nodes[levelNodes[i]];
+            if (node.faceCount == 0) {
+                levelNodes.push_back(node.leftChild);
+                levelNodes.push_back(node.rightChild);
+            }
+        }
+        levelStart = levelEnd;
+    }
+    levelOffsets.push_back(levelNodes.size());
+}
+
+float BVH::computeSahCost() const {
+    if (nodes.empty())
+        return 0.0f;
+
+    std::mutex sumMutex;
+    double cost = 0.0;
+    ThreadPool::get().parallelFor(nodes.size(), 1 << 14, [&](size_t begin, size_t end) {
+        double partial = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            const BVHNode& node = nodes[i];
+            const double area = node.bbox.surfaceArea();
+            partial += node.faceCount > 0 ? SAH_INTERSECTION_COST * node.faceCount * area : SAH_TRAVERSAL_COST * area;
+        }
+        std::lock_guard lock(sumMutex);
+        cost += partial;
+    });
+
+    const double rootArea = nodes[0].bbox.surfaceArea();
+    return rootArea > 0.0 ? static_cast<float>(cost / rootArea) : 0.0f;
+}
+
+void BVH::updateBounds(const bool recomputeLeaves) {
+    if (levelOffsets.empty())
+        buildLevels();
+
+    // Bottom-up, nodes within a level are independent
+    for (size_t level = levelOffsets.size() - 1; level-- > 0;) {
+        const size_t levelStart = levelOffsets[level];
+        const size_t levelSize = levelOffsets[level + 1] - levelStart;
+        ThreadPool::get().parallelFor(levelSize, 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                BVHNode& node = nodes[levelNodes[levelStart + i]];
+                if (node.faceCount > 0 && !recomputeLeaves)
+                    continue;
+                AABB bounds;
+                if (node.faceCount > 0) {
+                    for (int f = 0; f < node.faceCount && f < BVH_MAX_LEAF_SIZE; ++f) {
+                        const int face = node.faceIndices[f];
+                        for (int v = 0; v < 3; ++v)
+                            bounds.expand((*pPositions)[(*pIndices)[face * 3 + v]]);
+                    }
+                } else {
+                    bounds.expand(nodes[node.leftChild].bbox);
+                    bounds.expand(nodes[node.rightChild].bbox);
+                }
+                node.bbox = bounds;
+            }
+        });
+    }
+}
+
+bool BVH::refit(const Context& context) {
+    if (nodes.empty())
+        return false;
+
+    updateBounds(true);
+
+    // Refitting keeps the topology, which degrades as primitives move away from their original neighbors
+    if (computeSahCost() > builtSahCost * BVH_REFIT_REBUILD_RATIO) {
+        buildNodes(false);
+        buildTraversalNodes(context);
+        return true;
+    }
+
+    // The topology is unchanged, so only the bounds and triangles move
+    quantizeWideNodes();
+    updateRopes();
+    buildTriangles();
+    nodesBuffer.update(context, wideNodes.data(), sizeof(WideBVHNode) * wideNodes.size());
+    triangleBuffer.update(context, triangles.data(), sizeof(BVHTriangle) * triangles.size());
+    ropeBuffer.update(context, ropeNodes.data(), sizeof(RopeBVHNode) * ropeNodes.size());
+    return false;
 }
 
 void BVH::buildIterative(std::vector<PrimitiveInfo>& primitiveInfo, const AABB& sceneBounds) {
@@ -134,6 +304,195 @@ void BVH::buildIterative(std::vector<PrimitiveInfo>& primitiveInfo, const AABB&
     }
 }
 
+namespace {
+
+// Spreads the lower 10 bits so there are two zero bits between each
+uint32_t expandBits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// 30-bit Morton code of a point in [0, 1]^3
+uint32_t mortonCode(const vec3& p) {
+    const vec3 scaled = glm::clamp(p * 1024.0f, vec3(0.0f), vec3(1023.0f));
+    return expandBits(static_cast<uint32_t>(scaled.x)) << 2 | expandBits(static_cast<uint32_t>(scaled.y)) << 1 | expandBits(static_cast<uint32_t>(scaled.z));
+}
+
+// LSD radix sort of Morton codes with their primitive, 3 passes of 10 bits. Each pass histograms and scatters per chunk in parallel.
+void radixSort(std::vector<uint32_t>& codes, std::vector<int>& values) {
+    constexpr int BITS = 10;
+    constexpr int BUCKETS = 1 << BITS;
+    const size_t count = codes.size();
+    ThreadPool& pool = ThreadPool::get();
+    const size_t chunkCount = std::clamp<size_t>(count / (1 << 16), 1, pool.getThreadCount() * 2);
+
+    std::vector<uint32_t> codesTemp(count);
+    std::vector<int> valuesTemp(count);
+    std::vector<uint32_t> histograms(chunkCount * BUCKETS);
+
+    for (int shift = 0; shift < 30; shift += BITS) {
+        std::fill(histograms.begin(), histograms.end(), 0u);
+        pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk) {
+                uint32_t* histogram = &histograms[chunk * BUCKETS];
+                for (size_t i = count * chunk / chunkCount; i < count * (chunk + 1) / chunkCount; ++i)
+                    histogram[(codes[i] >> shift) & (BUCKETS - 1)]++;
+            }
+        });
+
+        // Exclusive prefix over (bucket, chunk) keeps the sort stable
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                const uint32_t bucketCount = histograms[chunk * BUCKETS + bucket];
+                histograms[chunk * BUCKETS + bucket] = offset;
+                offset += bucketCount;
+            }
+        }
+
+        pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk) {
+                uint32_t* offsets = &histograms[chunk * BUCKETS];
+                for (size_t i = count * chunk / chunkCount; i < count * (chunk + 1) / chunkCount; ++i) {
+                    const uint32_t destination = offsets[(codes[i] >> shift) & (BUCKETS - 1)]++;
+                    codesTemp[destination] = codes[i];
+                    valuesTemp[destination] = values[i];
+                }
+            }
+        });
+        codes.swap(codesTemp);
+        values.swap(valuesTemp);
+    }
+}
+
+int countLeadingZeros(const uint32_t value) {
+    return value == 0 ? 32 : std::countl_zero(value);
+}
+
+} // namespace
+
+void BVH::buildLinear(const std::vector<PrimitiveInfo>& primitiveInfo) {
+    const int count = static_cast<int>(primitiveInfo.size());
+    ThreadPool& pool = ThreadPool::get();
+
+    // Morton codes are computed relative to the centroid bounds
+    AABB centroidBounds;
+    for (const auto& info : primitiveInfo)
+        centroidBounds.expand(info.centroid);
+    const vec3 extent = glm::max(centroidBounds.max - centroidBounds.min, vec3(1e-20f));
+
+    std::vector<uint32_t> codes(count);
+    std::vector<int> order(count);
+    pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            codes[i] = mortonCode((primitiveInfo[i].centroid - centroidBounds.min) / extent);
+            order[i] = static_cast<int>(i);
+        }
+    });
+    radixSort(codes, order);
+
+    // Karras 2012: internal node i splits at the highest differing bit of its key range.
+    // Children below count - 1 are internal nodes, leaves are encoded as count - 1 + primitive position.
+    const int internalCount = count - 1;
+    std::vector<int> leftChild(std::max(internalCount, 0)), rightChild(std::max(internalCount, 0));
+    std::vector<int> rangeFirst(std::max(internalCount, 0)), rangeLast(std::max(internalCount, 0));
+
+    auto delta = [&](const int i, const int j) {
+        if (j < 0 || j >= count)
+            return -1;
+        // Duplicate codes fall back to the position so every key stays unique
+        return codes[i] == codes[j] ? 32 + countLeadingZeros(static_cast<uint32_t>(i ^ j)) : countLeadingZeros(codes[i] ^ codes[j]);
+    };
+
+    pool.parallelFor(internalCount, 1 << 12, [&](size_t begin, size_t end) {
+        for (int i = static_cast<int>(begin); i < static_cast<int>(end); ++i) {
+            const int direction = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+            const int deltaMin = delta(i, i - direction);
+
+            int lengthMax = 2;
+            while (delta(i, i + lengthMax * direction) > deltaMin)
+                lengthMax *= 2;
+            int length = 0;
+            for (int t = lengthMax / 2; t >= 1; t /= 2)
+                if (delta(i, i + (length + t) * direction) > deltaMin)
+                    length += t;
+            const int j = i + length * direction;
+
+            const int deltaNode = delta(i, j);
+            int split = 0;
+            int step = length;
+            do {
+                step = (step + 1) >> 1;
+                if (delta(i, i + (split + step) * direction) > deltaNode)
+                    split += step;
+            } while (step > 1);
+            const int gamma = i + split * direction + std::min(direction, 0);
+
+            const int first = std::min(i, j);
+            const int last = std::max(i, j);
+            leftChild[i] = first == gamma ? internalCount + gamma : gamma;
+            rightChild[i] = last == gamma + 1 ? internalCount + gamma + 1 : gamma + 1;
+            rangeFirst[i] = first;
+            rangeLast[i] = last;
+        }
+    });
+
+    // Emit in the regular node layout, collapsing subtrees that fit into one leaf
+    struct EmitTask {
+        int karrasNode, nodeIndex;
+    };
+    std::vector<EmitTask> emitStack;
+    nodes.emplace_back();
+    emitStack.push_back({count == 1 ? internalCount : 0, 0});
+    while (!emitStack.empty()) {
+        const EmitTask task = emitStack.back();
+        emitStack.pop_back();
+
+        const bool isPrimitive = task.karrasNode >= internalCount;
+        const int first = isPrimitive ? task.karrasNode - internalCount : rangeFirst[task.karrasNode];
+        const int last = isPrimitive ? first : rangeLast[task.karrasNode];
+
+        if (last - first + 1 <= BVH_MAX_LEAF_SIZE) {
+            BVHNode& node = nodes[task.nodeIndex];
+            node.faceCount = last - first + 1;
+            node.leftChild = -1;
+            node.rightChild = -1;
+            for (int i = 0; i < node.faceCount; ++i)
+                node.faceIndices[i] = primitiveInfo[order[first + i]].faceIndex;
+            continue;
+        }
+
+        const int leftChildIndex = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        const int rightChildIndex = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+
+        BVHNode& node = nodes[task.nodeIndex];
+        node.leftChild = leftChildIndex;
+        node.rightChild = rightChildIndex;
+        node.faceCount = 0;
+        emitStack.push_back({rightChild[task.karrasNode], rightChildIndex});
+        emitStack.push_back({leftChild[task.karrasNode], leftChildIndex});
+    }
+
+    // Children are always emitted after their parent, so a reverse sweep computes all bounds
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+        BVHNode& node = nodes[i];
+        AABB bounds;
+        if (node.isLeaf()) {
+            for (int f = 0; f < node.faceCount; ++f)
+                bounds.expand(primitiveInfo[node.faceIndices[f]].bbox);
+        } else {
+            bounds.expand(nodes[node.leftChild].bbox);
+            bounds.expand(nodes[node.rightChild].bbox);
+        }
+        node.bbox = bounds;
+    }
+}
+
 bool BVH::findBestSplit(std::vector<PrimitiveInfo>& primitiveInfo, int start, int end, 
                        const AABB& bounds, int& bestAxis, int& bestSplitIndex) {
     int count = end - start;
@@ -183,4 +542,155 @@ bool BVH::findBestSplit(std::vector<PrimitiveInfo>& primitiveInfo, int start, in
     // Check if split is beneficial
     float leafCost = SAH_INTERSECTION_COST * count;
     return bestCost < leafCost;
-}
\ No newline at end of file
+}
+
+void BVH::buildTriangles() {
+    triangles.resize(primitiveReferences.size());
+    for (size_t i = 0; i < primitiveReferences.size(); ++i) {
+        const uint32_t face = primitiveReferences[i];
+        const vec3& v0 = (*pPositions)[(*pIndices)[face * 3 + 0]];
+        triangles[i] = {v0, face,
+                        (*pPositions)[(*pIndices)[face * 3 + 1]] - v0, 0.0f,
+                        (*pPositions)[(*pIndices)[face * 3 + 2]] - v0, 0.0f};
+    }
+}
+
+bool BVH::intersectTriangle(const int face, const vec3& origin, const vec3& direction, Hit& hit) const {
+    const vec3& v0 = (*pPositions)[(*pIndices)[face * 3 + 0]];
+    const BVHTriangle triangle{v0, static_cast<uint32_t>(face),
+                               (*pPositions)[(*pIndices)[face * 3 + 1]] - v0, 0.0f,
+                               (*pPositions)[(*pIndices)[face * 3 + 2]] - v0, 0.0f};
+    return intersectTriangle(triangle, origin, direction, hit);
+}
+
+bool BVH::intersectTriangle(const BVHTriangle& triangle, const vec3& origin, const vec3& direction, Hit& hit) const {
+    // Moeller-Trumbore, same tolerances as Intersection.glsl
+    const vec3& v0 = triangle.v0;
+    const vec3& e1 = triangle.e1;
+    const vec3& e2 = triangle.e2;
+    const vec3 pvec = cross(direction, e2);
+    const float det = dot(e1, pvec);
+    if (std::fabs(det) < 1e-5f)
+        return false;
+    const float invDet = 1.0f / det;
+    const vec3 tvec = origin - v0;
+    const float u = dot(tvec, pvec) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    const vec3 qvec = cross(tvec, e1);
+    const float v = dot(direction, qvec) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    const float t = dot(e2, qvec) * invDet;
+    if (t <= 1e-5f || t >= hit.t)
+        return false;
+    hit.t = t;
+    hit.primitiveIndex = static_cast<int>(triangle.primitiveIndex);
+    hit.barycentrics = vec3(1.0f - u - v, u, v);
+    return true;
+}
+
+bool BVH::occluded(const vec3& origin, const vec3& direction, const float tMax) const {
+    Hit hit{tMax};
+    if (wideNodes.empty())
+        return intersect(origin, direction, hit);
+    return intersectWide(origin, direction, hit, true, nullptr, nullptr);
+}
+
+bool BVH::intersect(const vec3& origin, const vec3& direction, Hit& hit, uint32_t* nodesVisited, uint32_t* trianglesTested) const {
+    if (nodes.empty())
+        return false;
+    // Before the wide nodes exist, e.g. while optimizing, the binary nodes are traversed
+    if (!wideNodes.empty())
+        return intersectWide(origin, direction, hit, false, nodesVisited, trianglesTested);
+
+    const vec3 invDir = 1.0f / direction;
+    const ivec3 dirIsNeg(invDir.x < 0.0f, invDir.y < 0.0f, invDir.z < 0.0f);
+    bool found = false;
+
+    int stack[BVH_MAX_DEPTH + 2];
+    int stackPtr = 0;
+    stack[stackPtr++] = 0;
+    while (stackPtr > 0) {
+        const BVHNode& node = nodes[stack[--stackPtr]];
+        if (nodesVisited)
+            ++*nodesVisited;
+
+        float tNear, tFar;
+        if (!node.bbox.intersect(origin, invDir, dirIsNeg, tNear, tFar) || tFar < 0.0f || tNear > hit.t)
+            continue;
+
+        if (node.isLeaf()) {
+            for (int i = 0; i < node.faceCount && i < BVH_MAX_LEAF_SIZE; ++i) {
+                if (trianglesTested)
+                    ++*trianglesTested;
+                found = intersectTriangle(node.faceIndices[i], origin, direction, hit) || found;
+            }
+        } else if (stackPtr <= BVH_MAX_DEPTH) {
+            stack[stackPtr++] = node.leftChild;
+            stack[stackPtr++] = node.rightChild;
+        }
+    }
+    return found;
+}
+
+BVH::TraversalStats BVH::measureTraversal(const uint32_t rayCount) const {
+    TraversalStats stats;
+    stats.nodeCount = nodes.size();
+    stats.wideNodeCount = wideNodes.size();
+    stats.traversalBytes = sizeof(WideBVHNode) * wideNodes.size() + sizeof(BVHTriangle) * triangles.size() + sizeof(RopeBVHNode) * ropeNodes.size();
+    stats.sahCost = computeSahCost();
+    for (const BVHNode& node : nodes)
+        if (node.isLeaf())
+            stats.referenceCount += std::min(node.faceCount, BVH_MAX_LEAF_SIZE);
+    if (nodes.empty() || rayCount == 0)
+        return stats;
+
+    // Rays start on the bounding sphere and aim at a random point inside the bounds, seeded per ray so results are repeatable
+    const AABB& bounds = nodes[0].bbox;
+    const vec3 center = (bounds.min + bounds.max) * 0.5f;
+    const float radius = std::max(length(bounds.max - bounds.min) * 0.5f, 1e-6f);
+
+    std::mutex sumMutex;
+    uint64_t totalNodes = 0, totalTriangles = 0, totalStacklessNodes = 0;
+    ThreadPool::get().parallelFor(rayCount, 256, [&](size_t begin, size_t end) {
+        uint64_t localNodes = 0, localTriangles = 0, localStacklessNodes = 0;
+        for (size_t ray = begin; ray < end; ++ray) {
+            uint32_t state = static_cast<uint32_t>(ray) * 747796405u + 2891336453u;
+            auto random = [&state] {
+                state = state * 747796405u + 2891336453u;
+                uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+                return static_cast<float>((word >> 22u) ^ word) * (1.0f / 4294967296.0f);
+            };
+
+            const float z = 1.0f - 2.0f * random();
+            const float phi = 6.2831853f * random();
+            const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            const vec3 origin = center + radius * vec3(r * std::cos(phi), r * std::sin(phi), z);
+            const vec3 target = bounds.min + (bounds.max - bounds.min) * vec3(random(), random(), random());
+            const vec3 direction = normalize(target - origin + vec3(1e-7f));
+
+            Hit hit{std::numeric_limits<float>::max()};
+            uint32_t nodesVisited = 0, trianglesTested = 0;
+            intersect(origin, direction, hit, &nodesVisited, &trianglesTested);
+            localNodes += nodesVisited;
+            localTriangles += trianglesTested;
+
+            if (!ropeNodes.empty()) {
+                Hit stacklessHit{std::numeric_limits<float>::max()};
+                uint32_t stacklessNodesVisited = 0;
+                intersectStackless(origin, direction, stacklessHit, &stacklessNodesVisited);
+                localStacklessNodes += stacklessNodesVisited;
+            }
+        }
+        std::lock_guard lock(sumMutex);
+        totalNodes += localNodes;
+        totalTriangles += localTriangles;
+        totalStacklessNodes += localStacklessNodes;
+    });
+
+    stats.nodesPerRay = static_cast<float>(static_cast<double>(totalNodes) / rayCount);
+    stats.trianglesPerRay = static_cast<float>(static_cast<double>(totalTriangles) / rayCount);
+    stats.stacklessNodesPerRay = static_cast<float>(static_cast<double>(totalStacklessNodes) / rayCount);
+    return stats;
+}
@@ -1,12 +1,67 @@
 ﻿#pragma once
 
+#include <array>
 #include <vector>
 #include <glm/glm.hpp>
 #include "Shaders/SharedStructs.h"
 #include "Vulkan/Buffer.h"
 
+#define BVH_MAX_DEPTH 128
+// Traversal leaves pack the first primitive reference and the count into one int, 28 bits are left for the reference
+#define BVH_MAX_REFERENCES (1u << 28)
+
+// Surface Area Heuristic constants
+#define SAH_TRAVERSAL_COST 1.0f
+#define SAH_INTERSECTION_COST 1.0f
+
 class BVH
 {
+public:
+    enum class Builder {
+        SAH,  // Object splits only, full sweep
+        SBVH, // Object and spatial splits, triangles may be referenced by several leaves
+        LBVH  // Morton order with a Karras hierarchy, fastest to build but lowest quality
+    };
+
+    struct BuildOptions {
+        Builder builder = Builder::SAH;
+        // SBVH only: extra triangle references allowed, as a fraction of the triangle count
+        float spatialSplitBudget = 0.5f;
+        // Post-build reinsertion pass, paid once per asset since the result is cached
+        bool optimize = false;
+
+        bool operator==(const BuildOptions&) const = default;
+    };
+
+    struct Hit {
+        float t;
+        int primitiveIndex = -1;
+        vec3 barycentrics{0.0f};
+    };
+
+    // Averages over a fixed set of random rays through the mesh bounds
+    struct TraversalStats {
+        float nodesPerRay = 0.0f;
+        float trianglesPerRay = 0.0f;
+        float sahCost = 0.0f;
+        size_t nodeCount = 0;
+        size_t referenceCount = 0;
+        float stacklessNodesPerRay = 0.0f;
+        size_t wideNodeCount = 0;
+        size_t traversalBytes = 0; // Wide nodes and leaf triangles as uploaded
+    };
+
+    struct OptimizationReport {
+        bool valid = false; // False when the tree came from the cache or was not optimized
+        float sahBefore = 0.0f;
+        float sahAfter = 0.0f;
+        float nodesPerRayBefore = 0.0f;
+        float nodesPerRayAfter = 0.0f;
+        float milliseconds = 0.0f;
+        int reinsertions = 0;
+    };
+
+private:
     // Temporary struct used only during the build process.
     struct PrimitiveInfo {
         int faceIndex;
@@ -14,18 +69,79 @@ class BVH
         AABB bbox;
     };
 
+    // Binary nodes are built, cached, optimized and refitted, the wide nodes collapsed from them are traversed
     std::vector<BVHNode> nodes;
+    std::vector<WideBVHNode> wideNodes;
+    // Binary node of every wide node and of its children, kept so refitting only requantizes
+    std::vector<std::array<int, WIDE_BVH_WIDTH + 1>> wideSources;
+    std::vector<uint32_t> primitiveReferences;
+    std::vector<BVHTriangle> triangles; // One per primitive reference
+    std::vector<RopeBVHNode> ropeNodes;
+    std::vector<int> ropeSources;
     Buffer nodesBuffer;
+    Buffer triangleBuffer;
+    Buffer ropeBuffer;
+    BuildOptions options;
 
     // Non-owning pointers to the original mesh data
-    const std::vector<Vertex>* pVertices = nullptr;
+    const std::vector<vec3>* pPositions = nullptr;
     const std::vector<uint32_t>* pIndices = nullptr;
-    
+
+    // Node indices grouped by depth for refitting, built on first use
+    std::vector<int> levelNodes;
+    std::vector<size_t> levelOffsets;
+    float builtSahCost = 0.0f;
+    OptimizationReport optimizationReport;
+
+    void buildNodes(bool useCache);
+    void buildLevels();
+    // Traversal layouts derived from the binary nodes, see RopeBVH.cpp and WideBVH.cpp.
+    // The ropes also lay out the leaf references, depth first, and return the first reference of every binary leaf.
+    std::vector<uint32_t> buildRopes();
+    void updateRopes();
+    void buildWideNodes(const std::vector<uint32_t>& leafReferenceOffsets);
+    void quantizeWideNodes();
+    // Positions of the referenced faces, rerun whenever the vertices move
+    void buildTriangles();
+    void buildTraversalNodes(const Context& context);
+    bool intersectTriangle(const BVHTriangle& triangle, const vec3& origin, const vec3& direction, Hit& hit) const;
+    bool intersectTriangle(int face, const vec3& origin, const vec3& direction, Hit& hit) const;
+    // anyHit returns on the first hit closer than hit.t
+    bool intersectWide(const vec3& origin, const vec3& direction, Hit& hit, bool anyHit, uint32_t* nodesVisited, uint32_t* trianglesTested) const;
+    // Bottom-up bounds update, leaves keep their bounds unless recomputeLeaves is set
+    void updateBounds(bool recomputeLeaves);
     void buildIterative(std::vector<PrimitiveInfo>& primitiveInfo, const AABB& sceneBounds);
+    void buildSpatialSplits(const std::vector<PrimitiveInfo>& primitiveInfo, const AABB& sceneBounds);
+    void buildLinear(const std::vector<PrimitiveInfo>& primitiveInfo);
+    // Reinsertion optimization, see BVHOptimizer.cpp
+    void optimize();
     bool findBestSplit(std::vector<PrimitiveInfo>& primitiveInfo, int start, int end, const AABB& bounds, int& bestAxis, int& bestSplitIndex);
     
 public:
-    void build(const Context& context, const std::vector<Vertex>& inputVertices, const std::vector<uint32_t>& inputIndices);
+    void build(const Context& context, const std::vector<vec3>& inputPositions, const std::vector<uint32_t>& inputIndices, const BuildOptions& buildOptions);
+    // Recomputes the bounds after the vertex positions changed in place and uploads the nodes.
+    // Rebuilds instead when the tree quality degraded too far, returns true in that case.
+    bool refit(const Context& context);
+    // SAH cost of the current tree, normalized by the root surface area
+    float computeSahCost() const;
+
+    // Closest hit on the CPU, hit.t limits the search. Optionally counts visited nodes and tested triangles.
+    bool intersect(const vec3& origin, const vec3& direction, Hit& hit, uint32_t* nodesVisited = nullptr, uint32_t* trianglesTested = nullptr) const;
+    // True if anything is hit closer than tMax, stops at the first hit. The direction does not need to be normalized.
+    bool occluded(const vec3& origin, const vec3& direction, float tMax) const;
+    // Same query over the rope layout, without a stack
+    bool intersectStackless(const vec3& origin, const vec3& direction, Hit& hit, uint32_t* nodesVisited = nullptr, uint32_t* trianglesTested = nullptr) const;
+    TraversalStats measureTraversal(uint32_t rayCount = 1 << 14) const;
+
+    // Identifies the builder configuration, part of the BVH cache key
+    static uint64_t getBuilderKey(const BuildOptions& buildOptions);
+    const BuildOptions& getOptions() const { return options; }
+    const OptimizationReport& getOptimizationReport() const { return optimizationReport; }
     uint64_t getBufferAddress() const { return nodesBuffer.getDeviceAddress(); }
+    uint64_t getTriangleBufferAddress() const { return triangleBuffer.getDeviceAddress(); }
+    uint64_t getRopeBufferAddress() const { return ropeBuffer.getDeviceAddress(); }
     const std::vector<BVHNode>& getNodes() const { return nodes; }
+    // Root bounds, empty when nothing was built
+    AABB getBounds() const { return nodes.empty() ? AABB{} : nodes[0].bbox; }
+    const std::vector<WideBVHNode>& getWideNodes() const { return wideNodes; }
 };
\ No newline at end of file
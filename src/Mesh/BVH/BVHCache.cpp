@@ -0,0 +1,267 @@
+﻿#include "BVHCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "BVH.h"
+#include "ThreadPool.h"
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = {'N', 'R', 'B', 'V', 'H', 'C', 'H', 'E'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeSize;
+    uint64_t key;
+    uint64_t faceCount;
+    uint64_t nodeCount;
+};
+
+uint64_t mix(uint64_t h, const uint64_t value) {
+    h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h *= 0xFF51AFD7ED558CCDull;
+    return h ^ (h >> 33);
+}
+
+std::filesystem::path entryPath(const uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bvh", static_cast<unsigned long long>(key));
+    return BVHCache::getDirectory() / name;
+}
+
+bool contains(const AABB& outer, const AABB& inner) {
+    return all(lessThanEqual(outer.min, inner.min)) && all(lessThanEqual(inner.max, outer.max));
+}
+
+bool overlaps(const AABB& a, const AABB& b) {
+    return all(lessThanEqual(a.min, b.max)) && all(lessThanEqual(b.min, a.max));
+}
+
+// A corrupt entry could hold cycles or shared children that hang the level build and traversal,
+// so the tree has to reach every node exactly once from the root within BVH_MAX_DEPTH levels.
+// Leaf boxes must cover their triangles, clipped leaves together with the other references of the triangle.
+bool isValidTree(const std::vector<BVHNode>& nodes, const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, const bool clippedLeaves) {
+    std::vector<AABB> triangleBounds(indices.size() / 3);
+    for (size_t face = 0; face < triangleBounds.size(); ++face) {
+        for (int v = 0; v < 3; ++v) {
+            const uint32_t index = indices[face * 3 + v];
+            if (index >= positions.size())
+                return false;
+            triangleBounds[face].expand(positions[index]);
+        }
+    }
+
+    std::vector<AABB> coverage(triangleBounds.size());
+    std::vector<uint8_t> reached(nodes.size(), 0);
+    std::vector<std::pair<int, int>> stack{{0, 0}}; // Node, depth
+    size_t reachedCount = 0;
+    while (!stack.empty()) {
+        const auto [nodeIndex, depth] = stack.back();
+        stack.pop_back();
+        if (reached[nodeIndex] || depth > BVH_MAX_DEPTH)
+            return false;
+        reached[nodeIndex] = 1;
+        ++reachedCount;
+
+        const BVHNode& node = nodes[nodeIndex];
+        if (node.isLeaf()) {
+            for (int i = 0; i < node.faceCount; ++i) {
+                const int face = node.faceIndices[i];
+                if (clippedLeaves ? !overlaps(node.bbox, triangleBounds[face]) : !contains(node.bbox, triangleBounds[face]))
+                    return false;
+                coverage[face].expand(node.bbox);
+            }
+            continue;
+        }
+
+        for (const int child : {node.leftChild, node.rightChild}) {
+            if (!contains(node.bbox, nodes[child].bbox))
+                return false;
+            stack.emplace_back(child, depth + 1);
+        }
+    }
+    if (reachedCount != nodes.size())
+        return false;
+
+    // Also catches triangles that no leaf references
+    for (size_t face = 0; face < triangleBounds.size(); ++face)
+        if (!contains(coverage[face], triangleBounds[face]))
+            return false;
+    return true;
+}
+
+// Removes the least recently used entries until the directory fits BVH_CACHE_MAX_SIZE, keep is never removed
+void evict(const std::filesystem::path& keep) {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        uintmax_t size;
+    };
+
+    std::error_code error;
+    std::vector<Entry> entries;
+    uintmax_t totalSize = 0;
+    for (const auto& file : std::filesystem::directory_iterator(BVHCache::getDirectory(), error)) {
+        if (!file.is_regular_file(error) || file.path().extension() != ".bvh")
+            continue;
+        const uintmax_t size = file.file_size(error);
+        if (error)
+            continue;
+        totalSize += size;
+        if (file.path() != keep)
+            entries.push_back({file.path(), file.last_write_time(error), size});
+    }
+    if (totalSize <= BVH_CACHE_MAX_SIZE)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const Entry& entry : entries) {
+        if (totalSize <= BVH_CACHE_MAX_SIZE)
+            break;
+        if (std::filesystem::remove(entry.path, error))
+            totalSize -= entry.size;
+    }
+}
+
+} // namespace
+
+const std::filesystem::path& BVHCache::getDirectory() {
+    static const std::filesystem::path directory = [] {
+        std::filesystem::path base;
+        if (char* prefPath = SDL_GetPrefPath("NoorRay", "NoorRay")) {
+            base = prefPath;
+            SDL_free(prefPath);
+        } else {
+            base = std::filesystem::temp_directory_path() / "NoorRay";
+        }
+        return base / "BVHCache";
+    }();
+    return directory;
+}
+
+uint64_t BVHCache::hashGeometry(const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, const uint64_t builderKey) {
+    const size_t faceCount = indices.size() / 3;
+
+    // Hash fixed size blocks in parallel and combine the block hashes in order, so the result does not depend on the thread count
+    constexpr size_t blockSize = 1 << 14;
+    const size_t blockCount = (faceCount + blockSize - 1) / blockSize;
+    std::vector<uint64_t> blockHashes(blockCount);
+
+    ThreadPool::get().parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            uint64_t h = block;
+            const size_t last = std::min(faceCount, (block + 1) * blockSize);
+            for (size_t face = block * blockSize; face < last; ++face) {
+                for (int v = 0; v < 3; ++v) {
+                    const uint32_t index = indices[face * 3 + v];
+                    const vec3& p = positions[index];
+                    uint32_t bits[3];
+                    std::memcpy(bits, &p, sizeof(bits));
+                    h = mix(h, (static_cast<uint64_t>(bits[0]) << 32) | bits[1]);
+                    h = mix(h, (static_cast<uint64_t>(bits[2]) << 32) | index);
+                }
+            }
+            blockHashes[block] = h;
+        }
+    });
+
+    uint64_t h = mix(builderKey, faceCount);
+    for (const uint64_t blockHash : blockHashes)
+        h = mix(h, blockHash);
+    return h;
+}
+
+bool BVHCache::load(const uint64_t key, const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, const bool clippedLeaves, std::vector<BVHNode>& nodes) {
+    const size_t faceCount = indices.size() / 3;
+    const std::filesystem::path path = entryPath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    CacheHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header.version != CACHE_VERSION
+        || header.nodeSize != sizeof(BVHNode)
+        || header.key != key
+        || header.faceCount != faceCount
+        || header.nodeCount == 0)
+        return false;
+
+    // Spatial splits make the node count data dependent, so check it against the file instead
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(path, error);
+    if (error || fileSize != sizeof(CacheHeader) + sizeof(BVHNode) * header.nodeCount)
+        return false;
+
+    std::vector<BVHNode> cached(header.nodeCount);
+    if (!file.read(reinterpret_cast<char*>(cached.data()), static_cast<std::streamsize>(sizeof(BVHNode) * cached.size())))
+        return false;
+
+    // Reject anything that could send traversal out of bounds
+    const auto nodeCount = static_cast<int64_t>(cached.size());
+    for (const BVHNode& node : cached) {
+        if (node.faceCount > 0) {
+            if (node.faceCount > BVH_MAX_LEAF_SIZE)
+                return false;
+            for (int i = 0; i < node.faceCount; ++i)
+                if (node.faceIndices[i] < 0 || static_cast<size_t>(node.faceIndices[i]) >= faceCount)
+                    return false;
+        } else if (node.leftChild <= 0 || node.leftChild >= nodeCount || node.rightChild <= 0 || node.rightChild >= nodeCount) {
+            return false;
+        }
+    }
+    if (!isValidTree(cached, positions, indices, clippedLeaves))
+        return false;
+
+    // Loading counts as a use for the eviction order
+    file.close();
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    nodes = std::move(cached);
+    return true;
+}
+
+void BVHCache::store(const uint64_t key, const size_t faceCount, const std::vector<BVHNode>& nodes) {
+    std::error_code error;
+    std::filesystem::create_directories(getDirectory(), error);
+    if (error) {
+        std::cerr << "Warning: Could not create BVH cache directory: " << error.message() << std::endl;
+        return;
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.nodeSize = sizeof(BVHNode);
+    header.key = key;
+    header.faceCount = faceCount;
+    header.nodeCount = nodes.size();
+
+    // Write to a temporary file first so a crash never leaves a truncated entry behind
+    const std::filesystem::path path = entryPath(key);
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(sizeof(BVHNode) * nodes.size()));
+        if (!file) {
+            std::cerr << "Warning: Could not write BVH cache entry " << tempPath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+    evict(path);
+}
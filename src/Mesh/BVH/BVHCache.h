@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "Shaders/SharedStructs.h"
+
+// Bytes the cache directory may hold
+#define BVH_CACHE_MAX_SIZE (2ull << 30)
+
+// On-disk cache of built BVHs, keyed by a hash of the triangle geometry and the builder parameters.
+class BVHCache {
+public:
+    // Hash of all triangle positions (in index order) mixed with builderKey
+    static uint64_t hashGeometry(const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, uint64_t builderKey);
+
+    // Returns false if there is no entry or the entry does not pass validation. The tree is walked from the root
+    // and every box is checked against the geometry. clippedLeaves allows leaf boxes that only overlap their
+    // triangles, as spatial splits produce.
+    static bool load(uint64_t key, const std::vector<vec3>& positions, const std::vector<uint32_t>& indices, bool clippedLeaves, std::vector<BVHNode>& nodes);
+    // Failures are reported but not fatal, the cache is only an optimization.
+    // Least recently used entries are evicted once the directory grows past BVH_CACHE_MAX_SIZE.
+    static void store(uint64_t key, size_t faceCount, const std::vector<BVHNode>& nodes);
+
+    static const std::filesystem::path& getDirectory();
+};
@@ -0,0 +1,257 @@
+﻿#include "BVH.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <queue>
+
+#include "ThreadPool.h"
+
+// Node reinsertion (Bittner et al. 2013, batched as in Meister and Bittner 2018): nodes are taken out of the tree
+// and put back where they increase the total surface area the least. Insertion points for a batch are searched in
+// parallel against the unmodified tree, then applied one by one, skipping moves that touch nodes an earlier move changed.
+
+// Every node is tried once, largest surface area first, spread over this many rounds
+#define REINSERTION_ROUNDS 8
+// Batches per round, every batch pays for one bounds update and SAH evaluation of the whole tree
+#define REINSERTION_BATCHES_PER_ROUND 16
+#define REINSERTION_MIN_BATCH_SIZE 256
+
+namespace {
+
+struct Link {
+    int node;
+    int leftChild;
+    int rightChild;
+    int parent;
+};
+
+struct Move {
+    int node = -1;
+    int target = -1;
+    float gain = 0.0f;
+};
+
+float areaOf(const AABB& box) {
+    return box.surfaceArea();
+}
+
+AABB merged(AABB a, const AABB& b) {
+    a.expand(b);
+    return a;
+}
+
+} // namespace
+
+void BVH::optimize() {
+    if (nodes.size() < 5)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    optimizationReport = {};
+    optimizationReport.sahBefore = computeSahCost();
+    // Counted on the wide nodes that traversal walks, so the numbers match the BVH panel's statistics
+    auto wideNodesPerRay = [this] {
+        buildWideNodes(buildRopes());
+        buildTriangles();
+        return measureTraversal().nodesPerRay;
+    };
+    optimizationReport.nodesPerRayBefore = wideNodesPerRay();
+
+    const int nodeCount = static_cast<int>(nodes.size());
+    std::vector<int> parents(nodeCount, -1);
+    auto updateParents = [&] {
+        for (int i = 0; i < nodeCount; ++i) {
+            if (!nodes[i].isLeaf()) {
+                parents[nodes[i].leftChild] = i;
+                parents[nodes[i].rightChild] = i;
+            }
+        }
+    };
+    updateParents();
+
+    auto sibling = [&](const int node) {
+        const BVHNode& parent = nodes[parents[node]];
+        return parent.leftChild == node ? parent.rightChild : parent.leftChild;
+    };
+    auto replaceChild = [&](const int parent, const int oldChild, const int newChild) {
+        if (nodes[parent].leftChild == oldChild)
+            nodes[parent].leftChild = newChild;
+        else
+            nodes[parent].rightChild = newChild;
+        parents[newChild] = parent;
+    };
+
+    // Best place for node, read only. Gain is the surface area removed minus the area added.
+    auto findMove = [&](const int node) {
+        Move move;
+        const int parent = parents[node];
+        if (parent <= 0)
+            return move; // Children of the root would have to replace it
+        const int siblingNode = sibling(node);
+        const AABB& box = nodes[node].bbox;
+        const float nodeArea = areaOf(box);
+
+        // Taking the node out removes its parent and shrinks every ancestor
+        float removed = areaOf(nodes[parent].bbox);
+        std::vector<std::pair<int, AABB>> ancestors;
+        AABB refitted = nodes[siblingNode].bbox;
+        int child = parent;
+        for (int ancestor = parents[parent]; ancestor >= 0; child = ancestor, ancestor = parents[ancestor]) {
+            const BVHNode& a = nodes[ancestor];
+            refitted = merged(refitted, nodes[a.leftChild == child ? a.rightChild : a.leftChild].bbox);
+            removed += areaOf(a.bbox) - areaOf(refitted);
+            ancestors.emplace_back(ancestor, refitted);
+        }
+        // The search runs on the tree without the node, so ancestors use their shrunk bounds
+        auto boundsOf = [&](const int index) -> const AABB& {
+            for (const auto& [ancestor, bounds] : ancestors)
+                if (ancestor == index)
+                    return bounds;
+            return nodes[index].bbox;
+        };
+
+        // Branch and bound over insertion points, ordered by the area already induced on the way down
+        float bestCost = removed;
+        using Entry = std::pair<float, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+        queue.emplace(0.0f, 0);
+        while (!queue.empty()) {
+            const auto [induced, candidate] = queue.top();
+            queue.pop();
+            if (induced + nodeArea >= bestCost)
+                break;
+
+            // The removed parent is replaced by the sibling
+            const int target = candidate == parent ? siblingNode : candidate;
+            const AABB& targetBounds = boundsOf(target);
+            const float mergedArea = areaOf(merged(targetBounds, box));
+            const float cost = induced + mergedArea;
+            if (cost < bestCost && target != 0 && target != siblingNode) {
+                bestCost = cost;
+                move.target = target;
+            }
+
+            const BVHNode& t = nodes[target];
+            if (!t.isLeaf()) {
+                const float childInduced = induced + mergedArea - areaOf(targetBounds);
+                if (childInduced + nodeArea < bestCost) {
+                    for (const int next : {t.leftChild, t.rightChild})
+                        if (next != node)
+                            queue.emplace(childInduced, next);
+                }
+            }
+        }
+
+        if (move.target >= 0) {
+            move.node = node;
+            move.gain = removed - bestCost;
+        }
+        return move;
+    };
+
+    std::vector<bool> tried(nodeCount, false);
+    const int candidatesPerRound = std::max(REINSERTION_MIN_BATCH_SIZE, (nodeCount + REINSERTION_ROUNDS - 1) / REINSERTION_ROUNDS);
+    const size_t batchSize = std::max(REINSERTION_MIN_BATCH_SIZE, candidatesPerRound / REINSERTION_BATCHES_PER_ROUND);
+    float currentCost = optimizationReport.sahBefore;
+
+    for (int round = 0; round < REINSERTION_ROUNDS; ++round) {
+        std::vector<int> candidates;
+        candidates.reserve(nodeCount);
+        for (int i = 1; i < nodeCount; ++i)
+            if (!tried[i] && parents[i] > 0)
+                candidates.push_back(i);
+        if (candidates.empty())
+            break;
+
+        const size_t roundSize = std::min<size_t>(candidates.size(), candidatesPerRound);
+        std::partial_sort(candidates.begin(), candidates.begin() + roundSize, candidates.end(), [&](const int a, const int b) {
+            return areaOf(nodes[a].bbox) > areaOf(nodes[b].bbox);
+        });
+        candidates.resize(roundSize);
+
+        for (size_t batchStart = 0; batchStart < candidates.size(); batchStart += batchSize) {
+            const size_t batchEnd = std::min(candidates.size(), batchStart + batchSize);
+            std::vector<Move> moves(batchEnd - batchStart);
+            ThreadPool::get().parallelFor(moves.size(), 4, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    moves[i] = findMove(candidates[batchStart + i]);
+            });
+            for (size_t i = batchStart; i < batchEnd; ++i)
+                tried[candidates[i]] = true;
+
+            std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.gain > b.gain; });
+
+            // Links of every node a move changes, so a batch that made things worse can be undone
+            std::vector<Link> undo;
+            std::vector<bool> touched(nodeCount, false);
+            int applied = 0;
+            for (const Move& move : moves) {
+                if (move.node < 0 || move.gain <= 0.0f)
+                    break;
+                const int node = move.node;
+                const int parent = parents[node];
+                const int siblingNode = sibling(node);
+                const int grandParent = parents[parent];
+                const int target = move.target;
+                const int targetParent = parents[target];
+                if (grandParent < 0 || targetParent < 0)
+                    continue;
+
+                bool conflict = false;
+                for (const int n : {node, parent, siblingNode, grandParent, target, targetParent})
+                    conflict = conflict || touched[n];
+                // The target must not have moved into the subtree of the node
+                for (int a = target; a >= 0 && !conflict; a = parents[a])
+                    conflict = a == node;
+                if (conflict)
+                    continue;
+
+                for (const int n : {node, parent, siblingNode, grandParent, target, targetParent})
+                    undo.push_back({n, nodes[n].leftChild, nodes[n].rightChild, parents[n]});
+
+                // Detach: the sibling takes the place of the parent
+                replaceChild(grandParent, parent, siblingNode);
+                // Reinsert: the freed parent becomes the parent of target and node
+                const int newTargetParent = parents[target];
+                replaceChild(newTargetParent, target, parent);
+                nodes[parent].leftChild = target;
+                nodes[parent].rightChild = node;
+                parents[target] = parent;
+                parents[node] = parent;
+
+                for (const int n : {node, parent, siblingNode, grandParent, target, targetParent})
+                    touched[n] = true;
+                ++applied;
+            }
+            if (applied == 0)
+                continue;
+
+            levelOffsets.clear();
+            updateBounds(false);
+
+            // Bounds were searched against the old tree, so keep the batch only if it actually helped and the stack depth still fits
+            const float newCost = computeSahCost();
+            if (newCost >= currentCost || levelOffsets.size() > BVH_MAX_DEPTH) {
+                for (auto link = undo.rbegin(); link != undo.rend(); ++link) {
+                    nodes[link->node].leftChild = link->leftChild;
+                    nodes[link->node].rightChild = link->rightChild;
+                    parents[link->node] = link->parent;
+                }
+                levelOffsets.clear();
+                updateBounds(false);
+                levelOffsets.clear();
+                continue;
+            }
+            currentCost = newCost;
+            optimizationReport.reinsertions += applied;
+        }
+    }
+
+    levelOffsets.clear();
+    levelNodes.clear();
+
+    optimizationReport.sahAfter = computeSahCost();
+    optimizationReport.nodesPerRayAfter = wideNodesPerRay();
+    optimizationReport.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    optimizationReport.valid = true;
+}
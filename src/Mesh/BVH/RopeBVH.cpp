@@ -0,0 +1,114 @@
+﻿#include "BVH.h"
+#include <algorithm>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+// Stackless layout: binary nodes in depth first order, each with a skip link to the node after its subtree.
+// Traversal moves to the next node on a hit and follows the skip link on a miss or after a leaf.
+
+std::vector<uint32_t> BVH::buildRopes() {
+    ropeNodes.clear();
+    ropeSources.clear();
+    primitiveReferences.clear();
+    std::vector<uint32_t> leafReferenceOffsets(nodes.size(), 0);
+    if (nodes.empty())
+        return leafReferenceOffsets;
+
+    ropeNodes.reserve(nodes.size());
+    ropeSources.reserve(nodes.size());
+    primitiveReferences.reserve(nodes.size());
+
+    // Subtree sizes, children come after their parents in breadth first order
+    if (levelOffsets.empty())
+        buildLevels();
+    std::vector<int> subtreeSizes(nodes.size(), 1);
+    for (auto it = levelNodes.rbegin(); it != levelNodes.rend(); ++it) {
+        const BVHNode& node = nodes[*it];
+        if (!node.isLeaf())
+            subtreeSizes[*it] = 1 + subtreeSizes[node.leftChild] + subtreeSizes[node.rightChild];
+    }
+
+    struct Entry {
+        int node;
+        int skip;
+    };
+    std::vector<Entry> stack;
+    stack.push_back({0, -1});
+    while (!stack.empty()) {
+        const auto [nodeIndex, skip] = stack.back();
+        stack.pop_back();
+
+        const BVHNode& node = nodes[nodeIndex];
+        const int ropeIndex = static_cast<int>(ropeNodes.size());
+        RopeBVHNode& rope = ropeNodes.emplace_back();
+        rope.min = node.bbox.min;
+        rope.max = node.bbox.max;
+        rope.skip = skip;
+        ropeSources.push_back(nodeIndex);
+
+        if (node.isLeaf()) {
+            const int count = std::min(node.faceCount, BVH_MAX_LEAF_SIZE);
+            if (primitiveReferences.size() >= BVH_MAX_REFERENCES)
+                throw std::runtime_error("BVH has more primitive references than the rope leaf encoding can address (" + std::to_string(BVH_MAX_REFERENCES) + ")");
+            leafReferenceOffsets[nodeIndex] = static_cast<uint32_t>(primitiveReferences.size());
+            rope.leaf = static_cast<int>(primitiveReferences.size() << 3 | count);
+            primitiveReferences.insert(primitiveReferences.end(), node.faceIndices, node.faceIndices + count);
+        } else {
+            // Left subtree first, the right child follows it
+            rope.leaf = -1;
+            const int rightIndex = ropeIndex + 1 + subtreeSizes[node.leftChild];
+            stack.push_back({node.rightChild, skip});
+            stack.push_back({node.leftChild, rightIndex});
+        }
+    }
+    return leafReferenceOffsets;
+}
+
+void BVH::updateRopes() {
+    ThreadPool::get().parallelFor(ropeNodes.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ropeNodes[i].min = nodes[ropeSources[i]].bbox.min;
+            ropeNodes[i].max = nodes[ropeSources[i]].bbox.max;
+        }
+    });
+}
+
+bool BVH::intersectStackless(const vec3& origin, const vec3& direction, Hit& hit, uint32_t* nodesVisited, uint32_t* trianglesTested) const {
+    if (ropeNodes.empty())
+        return false;
+
+    const vec3 invDir = 1.0f / direction;
+    bool found = false;
+    int index = 0;
+    while (index >= 0) {
+        const RopeBVHNode& node = ropeNodes[index];
+        if (nodesVisited)
+            ++*nodesVisited;
+
+        const vec3 t1 = (node.min - origin) * invDir;
+        const vec3 t2 = (node.max - origin) * invDir;
+        const vec3 tLow = glm::min(t1, t2);
+        const vec3 tHigh = glm::max(t1, t2);
+        const float tNear = std::max({tLow.x, tLow.y, tLow.z});
+        const float tFar = std::min({tHigh.x, tHigh.y, tHigh.z});
+        if (tNear > tFar || tFar < 0.0f || tNear > hit.t) {
+            index = node.skip;
+            continue;
+        }
+
+        if (node.leaf < 0) {
+            ++index;
+            continue;
+        }
+
+        const uint32_t leaf = static_cast<uint32_t>(node.leaf);
+        for (uint32_t i = leaf >> 3, last = (leaf >> 3) + (leaf & 7); i < last; ++i) {
+            if (trianglesTested)
+                ++*trianglesTested;
+            found = intersectTriangle(triangles[i], origin, direction, hit) || found;
+        }
+        index = node.skip;
+    }
+    return found;
+}
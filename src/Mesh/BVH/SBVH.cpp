@@ -0,0 +1,317 @@
+﻿#include "BVH.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+
+// Spatial split BVH (Stich et al. 2009). Object splits are evaluated as in the SAH builder, spatial splits
+// chop triangles at bin boundaries so long thin triangles no longer inflate the bounds of both children.
+
+#define SBVH_SPATIAL_BINS 32
+// Spatial splits are only tried when the children of the best object split overlap by more than this fraction of the root area
+#define SBVH_OVERLAP_THRESHOLD 1e-5f
+// Levels left below BVH_MAX_DEPTH in which nodes are split at the object median. Each halves the references,
+// so any node still reaches the leaf size before the depth limit and no reference is dropped.
+#define SBVH_MEDIAN_SPLIT_DEPTH 32
+
+namespace {
+
+struct Reference {
+    int faceIndex;
+    AABB bounds;
+
+    vec3 centroid() const { return (bounds.min + bounds.max) * 0.5f; }
+};
+
+bool isEmpty(const AABB& box) {
+    return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+float area(const AABB& box) {
+    return isEmpty(box) ? 0.0f : box.surfaceArea();
+}
+
+AABB intersection(const AABB& a, const AABB& b) {
+    AABB result;
+    result.min = glm::max(a.min, b.min);
+    result.max = glm::min(a.max, b.max);
+    return result;
+}
+
+AABB merged(AABB a, const AABB& b) {
+    a.expand(b);
+    return a;
+}
+
+// Bounds of the part of a triangle that lies in the slab [lo, hi] along axis
+AABB clipTriangle(const std::array<vec3, 3>& v, const int axis, const float lo, const float hi) {
+    AABB result;
+    for (int i = 0; i < 3; ++i) {
+        const vec3& a = v[i];
+        const vec3& b = v[(i + 1) % 3];
+        const float pa = a[axis];
+        const float pb = b[axis];
+
+        if (pa >= lo && pa <= hi)
+            result.expand(a);
+
+        for (const float plane : {lo, hi}) {
+            if ((pa < plane && pb > plane) || (pa > plane && pb < plane)) {
+                vec3 p = glm::mix(a, b, (plane - pa) / (pb - pa));
+                p[axis] = plane;
+                result.expand(p);
+            }
+        }
+    }
+    return result;
+}
+
+struct ObjectSplit {
+    float cost = std::numeric_limits<float>::max();
+    int axis = -1;
+    int index = 0;
+    AABB leftBounds, rightBounds;
+};
+
+struct SpatialSplit {
+    float cost = std::numeric_limits<float>::max();
+    int axis = -1;
+    float position = 0.0f;
+};
+
+ObjectSplit findObjectSplit(std::vector<Reference>& refs, const AABB& bounds) {
+    ObjectSplit best;
+    const int count = static_cast<int>(refs.size());
+    const float invArea = 1.0f / std::max(bounds.surfaceArea(), 1e-20f);
+    std::vector<AABB> rightBounds(count);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        std::sort(refs.begin(), refs.end(), [axis](const Reference& a, const Reference& b) {
+            return a.centroid()[axis] < b.centroid()[axis];
+        });
+
+        AABB currentBox;
+        for (int i = count - 1; i > 0; --i) {
+            currentBox.expand(refs[i].bounds);
+            rightBounds[i] = currentBox;
+        }
+
+        AABB leftBox;
+        for (int i = 1; i < count; ++i) {
+            leftBox.expand(refs[i - 1].bounds);
+            const float cost = SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST *
+                               (i * leftBox.surfaceArea() + (count - i) * rightBounds[i].surfaceArea()) * invArea;
+            if (cost < best.cost) {
+                best.cost = cost;
+                best.axis = axis;
+                best.index = i;
+                best.leftBounds = leftBox;
+                best.rightBounds = rightBounds[i];
+            }
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+void BVH::buildSpatialSplits(const std::vector<PrimitiveInfo>& primitiveInfo, const AABB& sceneBounds) {
+    auto triangle = [&](const int face) {
+        return std::array<vec3, 3>{
+            (*pPositions)[(*pIndices)[face * 3 + 0]],
+            (*pPositions)[(*pIndices)[face * 3 + 1]],
+            (*pPositions)[(*pIndices)[face * 3 + 2]]
+        };
+    };
+
+    struct BuildTask {
+        std::vector<Reference> refs;
+        AABB bounds;
+        int nodeIndex, depth;
+    };
+
+    std::vector<Reference> rootRefs;
+    rootRefs.reserve(primitiveInfo.size());
+    for (const auto& info : primitiveInfo)
+        rootRefs.push_back({info.faceIndex, info.bbox});
+
+    const size_t maxReferences = primitiveInfo.size() + static_cast<size_t>(static_cast<double>(primitiveInfo.size()) * std::max(options.spatialSplitBudget, 0.0f));
+    size_t referenceCount = primitiveInfo.size();
+    const float minOverlap = SBVH_OVERLAP_THRESHOLD * sceneBounds.surfaceArea();
+
+    std::vector<BuildTask> buildStack;
+    nodes.emplace_back();
+    buildStack.push_back({std::move(rootRefs), sceneBounds, 0, 0});
+
+    while (!buildStack.empty()) {
+        BuildTask task = std::move(buildStack.back());
+        buildStack.pop_back();
+        std::vector<Reference>& refs = task.refs;
+        const int count = static_cast<int>(refs.size());
+
+        nodes[task.nodeIndex].bbox = task.bounds;
+
+        if (count <= BVH_MAX_LEAF_SIZE) {
+            BVHNode& node = nodes[task.nodeIndex];
+            node.faceCount = count;
+            node.leftChild = -1;
+            node.rightChild = -1;
+            for (int i = 0; i < node.faceCount; ++i)
+                node.faceIndices[i] = refs[i].faceIndex;
+            continue;
+        }
+
+        // Close to the depth limit, split at the object median along the longest axis
+        const bool medianSplit = task.depth >= BVH_MAX_DEPTH - SBVH_MEDIAN_SPLIT_DEPTH;
+        ObjectSplit objectSplit;
+        if (medianSplit) {
+            const vec3 extent = task.bounds.max - task.bounds.min;
+            objectSplit.axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            objectSplit.index = count / 2;
+        } else {
+            objectSplit = findObjectSplit(refs, task.bounds);
+        }
+
+        // Spatial split binning
+        SpatialSplit spatialSplit;
+        const bool trySpatial = !medianSplit && referenceCount < maxReferences && area(intersection(objectSplit.leftBounds, objectSplit.rightBounds)) > minOverlap;
+        if (trySpatial) {
+            const float invArea = 1.0f / std::max(task.bounds.surfaceArea(), 1e-20f);
+            for (int axis = 0; axis < 3; ++axis) {
+                const float origin = task.bounds.min[axis];
+                const float extent = task.bounds.max[axis] - origin;
+                if (extent < 1e-6f)
+                    continue;
+                const float binSize = extent / SBVH_SPATIAL_BINS;
+                auto binOf = [&](const float p) { return std::clamp(static_cast<int>((p - origin) / binSize), 0, SBVH_SPATIAL_BINS - 1); };
+
+                std::array<AABB, SBVH_SPATIAL_BINS> binBounds;
+                std::array<int, SBVH_SPATIAL_BINS> entries{}, exits{};
+
+                for (const Reference& ref : refs) {
+                    const int first = binOf(ref.bounds.min[axis]);
+                    const int last = binOf(ref.bounds.max[axis]);
+                    entries[first]++;
+                    exits[last]++;
+                    if (first == last) {
+                        binBounds[first].expand(ref.bounds);
+                        continue;
+                    }
+                    const auto v = triangle(ref.faceIndex);
+                    for (int bin = first; bin <= last; ++bin) {
+                        const AABB clipped = intersection(clipTriangle(v, axis, origin + bin * binSize, origin + (bin + 1) * binSize), ref.bounds);
+                        if (!isEmpty(clipped))
+                            binBounds[bin].expand(clipped);
+                    }
+                }
+
+                std::array<AABB, SBVH_SPATIAL_BINS> rightBounds;
+                AABB rightBox;
+                for (int bin = SBVH_SPATIAL_BINS - 1; bin > 0; --bin) {
+                    rightBox.expand(binBounds[bin]);
+                    rightBounds[bin] = rightBox;
+                }
+
+                AABB leftBox;
+                int leftCount = 0;
+                int rightCount = count;
+                for (int bin = 1; bin < SBVH_SPATIAL_BINS; ++bin) {
+                    leftBox.expand(binBounds[bin - 1]);
+                    leftCount += entries[bin - 1];
+                    rightCount -= exits[bin - 1];
+                    const float cost = SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST *
+                                       (leftCount * area(leftBox) + rightCount * area(rightBounds[bin])) * invArea;
+                    if (cost < spatialSplit.cost) {
+                        spatialSplit.cost = cost;
+                        spatialSplit.axis = axis;
+                        spatialSplit.position = origin + bin * binSize;
+                    }
+                }
+            }
+        }
+
+        std::vector<Reference> leftRefs, rightRefs;
+        AABB leftBounds, rightBounds;
+
+        if (spatialSplit.cost < objectSplit.cost) {
+            const int axis = spatialSplit.axis;
+            const float plane = spatialSplit.position;
+
+            // Straddling references are classified last so the unsplit test sees the final bounds of the unambiguous ones
+            std::vector<const Reference*> straddling;
+            for (const Reference& ref : refs) {
+                if (ref.bounds.max[axis] <= plane) {
+                    leftRefs.push_back(ref);
+                    leftBounds.expand(ref.bounds);
+                } else if (ref.bounds.min[axis] >= plane) {
+                    rightRefs.push_back(ref);
+                    rightBounds.expand(ref.bounds);
+                } else {
+                    straddling.push_back(&ref);
+                }
+            }
+
+            for (const Reference* ref : straddling) {
+                const auto v = triangle(ref->faceIndex);
+                const AABB leftPart = intersection(clipTriangle(v, axis, ref->bounds.min[axis], plane), ref->bounds);
+                const AABB rightPart = intersection(clipTriangle(v, axis, plane, ref->bounds.max[axis]), ref->bounds);
+                const float nl = static_cast<float>(leftRefs.size());
+                const float nr = static_cast<float>(rightRefs.size());
+
+                // Reference unsplitting: keep the triangle on one side if that is cheaper than duplicating it
+                const float splitCost = area(merged(leftBounds, leftPart)) * (nl + 1) + area(merged(rightBounds, rightPart)) * (nr + 1);
+                const float leftOnlyCost = area(merged(leftBounds, ref->bounds)) * (nl + 1) + area(rightBounds) * nr;
+                const float rightOnlyCost = area(leftBounds) * nl + area(merged(rightBounds, ref->bounds)) * (nr + 1);
+
+                if (isEmpty(rightPart) || (leftOnlyCost <= splitCost && leftOnlyCost <= rightOnlyCost)) {
+                    leftRefs.push_back(*ref);
+                    leftBounds.expand(ref->bounds);
+                } else if (isEmpty(leftPart) || rightOnlyCost <= splitCost) {
+                    rightRefs.push_back(*ref);
+                    rightBounds.expand(ref->bounds);
+                } else {
+                    leftRefs.push_back({ref->faceIndex, leftPart});
+                    rightRefs.push_back({ref->faceIndex, rightPart});
+                    leftBounds.expand(leftPart);
+                    rightBounds.expand(rightPart);
+                }
+            }
+        }
+
+        // Object split, also the fallback when the spatial split degenerated
+        if (leftRefs.empty() || rightRefs.empty()) {
+            leftRefs.clear();
+            rightRefs.clear();
+            int splitIndex = count / 2;
+            if (objectSplit.axis != -1) {
+                const int axis = objectSplit.axis;
+                std::sort(refs.begin(), refs.end(), [axis](const Reference& a, const Reference& b) {
+                    return a.centroid()[axis] < b.centroid()[axis];
+                });
+                splitIndex = objectSplit.index;
+            }
+            leftRefs.assign(refs.begin(), refs.begin() + splitIndex);
+            rightRefs.assign(refs.begin() + splitIndex, refs.end());
+            leftBounds = AABB();
+            rightBounds = AABB();
+            for (const auto& ref : leftRefs) leftBounds.expand(ref.bounds);
+            for (const auto& ref : rightRefs) rightBounds.expand(ref.bounds);
+        }
+
+        referenceCount += leftRefs.size() + rightRefs.size() - refs.size();
+
+        const int leftChildIndex = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        const int rightChildIndex = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+
+        BVHNode& node = nodes[task.nodeIndex];
+        node.leftChild = leftChildIndex;
+        node.rightChild = rightChildIndex;
+        node.faceCount = 0;
+
+        refs.clear();
+        refs.shrink_to_fit();
+        buildStack.push_back({std::move(rightRefs), rightBounds, rightChildIndex, task.depth + 1});
+        buildStack.push_back({std::move(leftRefs), leftBounds, leftChildIndex, task.depth + 1});
+    }
+}
@@ -0,0 +1,210 @@
+﻿#include "BVH.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+// Collapses the binary tree into nodes with up to four children, opening the child with the largest surface area
+// first. Child bounds are stored as bytes on a power of two grid anchored at the node minimum. Traversal decodes
+// a bound as origin + q * step in float, q * step is exact but the sum is rounded. Rounding to nearest never
+// decreases, so the encoder checks each decoded bound against the child box and moves it out by a step where
+// the rounded grid position landed inside. Every decoded child box then contains the child.
+
+namespace {
+
+int encodeLeaf(const uint32_t firstReference, const int count) {
+    if (firstReference >= BVH_MAX_REFERENCES)
+        throw std::runtime_error("BVH has more primitive references than the wide leaf encoding can address (" + std::to_string(BVH_MAX_REFERENCES) + ")");
+    return ~static_cast<int>(firstReference << 3 | static_cast<uint32_t>(count));
+}
+
+} // namespace
+
+void BVH::buildWideNodes(const std::vector<uint32_t>& leafReferenceOffsets) {
+    wideNodes.clear();
+    wideSources.clear();
+    if (nodes.empty())
+        return;
+
+    wideNodes.reserve(nodes.size() / 2 + 1);
+    wideSources.reserve(nodes.size() / 2 + 1);
+
+    // A leaf root still gets a wide node, with the leaf as its only child
+    std::array<int, WIDE_BVH_WIDTH + 1> root;
+    root.fill(WIDE_BVH_EMPTY);
+    root[0] = 0;
+    if (nodes[0].isLeaf())
+        root[1] = 0;
+    wideSources.push_back(root);
+    wideNodes.emplace_back();
+    wideNodes.back().parent = -1;
+
+    // Wide nodes are created in the order they are reached, children are filled in when a node is processed
+    for (size_t wideIndex = 0; wideIndex < wideSources.size(); ++wideIndex) {
+        std::array<int, WIDE_BVH_WIDTH + 1> source = wideSources[wideIndex];
+        if (!nodes[source[0]].isLeaf()) {
+            int childCount = 2;
+            source[1] = nodes[source[0]].leftChild;
+            source[2] = nodes[source[0]].rightChild;
+            while (childCount < WIDE_BVH_WIDTH) {
+                int largest = -1;
+                float largestArea = -1.0f;
+                for (int i = 1; i <= childCount; ++i) {
+                    const BVHNode& child = nodes[source[i]];
+                    if (!child.isLeaf() && child.bbox.surfaceArea() > largestArea) {
+                        largestArea = child.bbox.surfaceArea();
+                        largest = i;
+                    }
+                }
+                if (largest < 0)
+                    break;
+                const BVHNode& opened = nodes[source[largest]];
+                source[largest] = opened.leftChild;
+                source[++childCount] = opened.rightChild;
+            }
+        }
+        wideSources[wideIndex] = source;
+
+        // Appending wide nodes below may reallocate, so the children are written afterwards
+        int children[WIDE_BVH_WIDTH];
+        for (int i = 0; i < WIDE_BVH_WIDTH; ++i) {
+            const int child = source[i + 1];
+            if (child == WIDE_BVH_EMPTY) {
+                children[i] = WIDE_BVH_EMPTY;
+            } else if (nodes[child].isLeaf()) {
+                const int count = std::min(nodes[child].faceCount, BVH_MAX_LEAF_SIZE);
+                children[i] = encodeLeaf(leafReferenceOffsets[child], count);
+            } else {
+                std::array<int, WIDE_BVH_WIDTH + 1> childSource;
+                childSource.fill(WIDE_BVH_EMPTY);
+                childSource[0] = child;
+                children[i] = static_cast<int>(wideSources.size());
+                wideSources.push_back(childSource);
+                wideNodes.emplace_back();
+                wideNodes.back().parent = static_cast<int>(wideIndex);
+            }
+        }
+        std::copy(children, children + WIDE_BVH_WIDTH, wideNodes[wideIndex].children);
+    }
+
+    quantizeWideNodes();
+}
+
+void BVH::quantizeWideNodes() {
+    ThreadPool::get().parallelFor(wideNodes.size(), 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const std::array<int, WIDE_BVH_WIDTH + 1>& source = wideSources[i];
+            WideBVHNode& wide = wideNodes[i];
+            const AABB& box = nodes[source[0]].bbox;
+
+            // Smallest power of two step for which 255 steps cover the node
+            vec3 step;
+            wide.origin = box.min;
+            wide.exponents = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                int exponent;
+                std::frexp(std::max(box.max[axis] - box.min[axis], 0.0f) / 255.0f, &exponent);
+                // The rounded extent can come up short of the decoded top of the grid
+                while (exponent < 127 && box.min[axis] + 255.0f * std::ldexp(1.0f, exponent) < box.max[axis])
+                    ++exponent;
+                exponent = std::clamp(exponent, -126, 127);
+                step[axis] = std::ldexp(1.0f, exponent);
+                wide.exponents |= static_cast<uint32_t>(exponent + 127) << (axis * 8);
+                wide.qMin[axis] = 0;
+                wide.qMax[axis] = 0;
+            }
+
+            for (int c = 0; c < WIDE_BVH_WIDTH; ++c) {
+                if (source[c + 1] == WIDE_BVH_EMPTY)
+                    continue;
+                const AABB& child = nodes[source[c + 1]].bbox;
+                for (int axis = 0; axis < 3; ++axis) {
+                    float low = std::clamp(std::floor((child.min[axis] - wide.origin[axis]) / step[axis]), 0.0f, 255.0f);
+                    float high = std::clamp(std::ceil((child.max[axis] - wide.origin[axis]) / step[axis]), 0.0f, 255.0f);
+                    // Decoded exactly as the traversal does, low 0 decodes to the origin itself
+                    while (low > 0.0f && wide.origin[axis] + low * step[axis] > child.min[axis])
+                        low -= 1.0f;
+                    while (high < 255.0f && wide.origin[axis] + high * step[axis] < child.max[axis])
+                        high += 1.0f;
+                    wide.qMin[axis] |= static_cast<uint32_t>(low) << (c * 8);
+                    wide.qMax[axis] |= static_cast<uint32_t>(high) << (c * 8);
+                }
+            }
+        }
+    });
+}
+
+bool BVH::intersectWide(const vec3& origin, const vec3& direction, Hit& hit, const bool anyHit, uint32_t* nodesVisited, uint32_t* trianglesTested) const {
+    const vec3 invDir = 1.0f / direction;
+    bool found = false;
+
+    // Every wide level pushes at most three more entries than it pops
+    int stack[BVH_MAX_DEPTH * (WIDE_BVH_WIDTH - 1) + 1];
+    int stackPtr = 0;
+    int nodeIndex = 0;
+    while (nodeIndex >= 0) {
+        const WideBVHNode& node = wideNodes[nodeIndex];
+        if (nodesVisited)
+            ++*nodesVisited;
+
+        // Interior children that were hit, sorted by entry distance
+        int nearChildren[WIDE_BVH_WIDTH];
+        float nearDistances[WIDE_BVH_WIDTH];
+        int nearCount = 0;
+
+        vec3 step;
+        for (int axis = 0; axis < 3; ++axis)
+            step[axis] = std::ldexp(1.0f, static_cast<int>(node.exponents >> (axis * 8) & 0xFF) - 127);
+
+        for (int c = 0; c < WIDE_BVH_WIDTH; ++c) {
+            const int child = node.children[c];
+            if (child == WIDE_BVH_EMPTY)
+                continue;
+
+            const uint32_t shift = c * 8;
+            const vec3 qMin(node.qMin[0] >> shift & 0xFF, node.qMin[1] >> shift & 0xFF, node.qMin[2] >> shift & 0xFF);
+            const vec3 qMax(node.qMax[0] >> shift & 0xFF, node.qMax[1] >> shift & 0xFF, node.qMax[2] >> shift & 0xFF);
+            const vec3 t1 = (node.origin + qMin * step - origin) * invDir;
+            const vec3 t2 = (node.origin + qMax * step - origin) * invDir;
+            const vec3 tLow = glm::min(t1, t2);
+            const vec3 tHigh = glm::max(t1, t2);
+            const float tNear = std::max({tLow.x, tLow.y, tLow.z});
+            const float tFar = std::min({tHigh.x, tHigh.y, tHigh.z});
+            if (tNear > tFar || tFar < 0.0f || tNear > hit.t)
+                continue;
+
+            if (child >= 0) {
+                int slot = nearCount++;
+                for (; slot > 0 && nearDistances[slot - 1] > tNear; --slot) {
+                    nearChildren[slot] = nearChildren[slot - 1];
+                    nearDistances[slot] = nearDistances[slot - 1];
+                }
+                nearChildren[slot] = child;
+                nearDistances[slot] = tNear;
+                continue;
+            }
+
+            const uint32_t leaf = static_cast<uint32_t>(~child);
+            for (uint32_t i = leaf >> 3, last = (leaf >> 3) + (leaf & 7); i < last; ++i) {
+                if (trianglesTested)
+                    ++*trianglesTested;
+                found = intersectTriangle(triangles[i], origin, direction, hit) || found;
+                if (found && anyHit)
+                    return true;
+            }
+        }
+
+        // Same order as traverseBVH: drop children behind a closer leaf hit, descend into the nearest, push the rest farthest first
+        while (nearCount > 0 && nearDistances[nearCount - 1] >= hit.t)
+            --nearCount;
+        for (int i = nearCount - 1; i > 0; --i)
+            stack[stackPtr++] = nearChildren[i];
+
+        if (nearCount > 0)
+            nodeIndex = nearChildren[0];
+        else
+            nodeIndex = stackPtr > 0 ? stack[--stackPtr] : -1;
+    }
+    return found;
+}
@@ -1,6 +1,7 @@
 ﻿#include "MeshAsset.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <memory>
@@ -9,8 +10,24 @@
 #include <numbers>
 #include "imgui.h"
 #include "glm/gtc/type_ptr.inl"
+#include "glm/gtc/packing.hpp"
 #include "UI/ImGuiManager.h"
 
+namespace {
+
+// Octahedral mapping of a unit vector to two snorm16, decoded by decodeOctahedral() in Common.glsl
+uint32_t encodeOctahedral(const vec3& v) {
+    const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (l1 == 0.0f)
+        return packSnorm2x16(vec2(0.0f));
+    vec2 e = vec2(v.x, v.y) / l1;
+    if (v.z < 0.0f)
+        e = (1.0f - abs(vec2(e.y, e.x))) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return packSnorm2x16(e);
+}
+
+} // namespace
+
 std::shared_ptr<MeshAsset> MeshAsset::CreateCube(Scene& scene, const std::string& name, const Material& material) {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
@@ -220,34 +237,129 @@ std::shared_ptr<MeshAsset> MeshAsset::CreateDisk(Scene& scene, const std::string
 }
 
 MeshAsset::MeshAsset(Scene& scene, const std::string& name, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Face>& faces, const std::vector<Material>& materials)
-    : scene(scene), path(name), vertices(vertices), indices(indices), faces(faces), materials(materials)
+    : scene(scene), path(name), indices(indices), materials(materials)
 {
+    setVertices(vertices);
+    sortFacesByMaterial(faces);
 
     // Upload mesh data to GPU from the new member variable copies
-    vertexBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(Vertex) * this->vertices.size(), this->vertices.data()};
+    positionBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(vec3) * positions.size(), positions.data()};
+    attributeBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(VertexAttributes) * attributes.size(), attributes.data()};
     indexBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(uint32_t) * this->indices.size(), this->indices.data()};
-    faceBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(Face) * this->faces.size(), this->faces.data()};
+    materialRangeBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(MaterialRange) * materialRanges.size(), materialRanges.data()};
     materialBuffer = Buffer{scene.getContext(), Buffer::Type::AccelInput , sizeof(Material) * this->materials.size(), this->materials.data()};
 
-    if (scene.getContext().isRtxSupported()) {
-        vk::AccelerationStructureGeometryTrianglesDataKHR triangleData{};
-        triangleData.setVertexFormat(vk::Format::eR32G32B32Sfloat);
-        triangleData.setVertexData(vertexBuffer.getDeviceAddress());
-        triangleData.setVertexStride(sizeof(Vertex));
-        triangleData.setMaxVertex(static_cast<uint32_t>(this->vertices.size()));
-        triangleData.setIndexType(vk::IndexType::eUint32);
-        triangleData.setIndexData(indexBuffer.getDeviceAddress());
+    if (scene.getContext().isRtxSupported())
+        // Create bottom-level acceleration structure (BLAS) on the GPU
+        blasGpu.build(scene.getContext(), createBlasGeometry(), getFaceCount(), vk::AccelerationStructureTypeKHR::eBottomLevel);
+    else
+        rebuildBvh();
+}
 
-        vk::AccelerationStructureGeometryKHR geometry{};
-        geometry.setGeometryType(vk::GeometryTypeKHR::eTriangles);
-        geometry.setGeometry({triangleData});
-        geometry.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
+void MeshAsset::rebuildBvh() {
+    blasCpu.build(scene.getContext(), positions, indices, bvhOptions);
+    // Measured when the BVH panel shows them, building alone should not pay for the benchmark rays
+    if (bvhStatsMeasured)
+        previousBvhStats = bvhStats;
+    bvhStatsMeasured = false;
+}
 
-        // Create bottom-level acceleration structure (BLAS) on the GPU
-        blasGpu.build(scene.getContext(), geometry, this->faces.size(), vk::AccelerationStructureTypeKHR::eBottomLevel);
+void MeshAsset::setVertices(const std::vector<Vertex>& newVertices) {
+    positions.resize(newVertices.size());
+    attributes.resize(newVertices.size());
+    for (size_t i = 0; i < newVertices.size(); ++i) {
+        const Vertex& vertex = newVertices[i];
+        positions[i] = vertex.position;
+        attributes[i] = {encodeOctahedral(vertex.normal), encodeOctahedral(vertex.tangent), packHalf2x16(vertex.uv)};
+    }
+}
+
+void MeshAsset::sortFacesByMaterial(const std::vector<Face>& faces) {
+    if (faces.size() * 3 != indices.size())
+        throw std::runtime_error(path + ": expected one face per triangle, got " + std::to_string(faces.size()) + " for " + std::to_string(indices.size() / 3));
+
+    materialRanges.clear();
+    if (faces.empty()) {
+        materialRanges.push_back({0, 0});
+        return;
+    }
+
+    // Counting sort keeps the original order within a material
+    const int materialCount = std::max_element(faces.begin(), faces.end(), [](const Face& a, const Face& b) {
+        return a.materialIndex < b.materialIndex;
+    })->materialIndex + 1;
+    std::vector<uint32_t> offsets(materialCount + 1, 0);
+    for (const Face& face : faces)
+        ++offsets[face.materialIndex + 1];
+    for (int m = 0; m < materialCount; ++m) {
+        if (offsets[m + 1] > 0)
+            materialRanges.push_back({offsets[m], m});
+        offsets[m + 1] += offsets[m];
+    }
+    if (materialRanges.size() == 1)
+        return;
+
+    std::vector<uint32_t> sortedIndices(indices.size());
+    for (size_t face = 0; face < faces.size(); ++face) {
+        const uint32_t target = offsets[faces[face].materialIndex]++;
+        std::copy_n(indices.begin() + face * 3, 3, sortedIndices.begin() + target * 3);
+    }
+    indices = std::move(sortedIndices);
+}
+
+vk::AccelerationStructureGeometryKHR MeshAsset::createBlasGeometry() const {
+    vk::AccelerationStructureGeometryTrianglesDataKHR triangleData{};
+    triangleData.setVertexFormat(vk::Format::eR32G32B32Sfloat);
+    triangleData.setVertexData(positionBuffer.getDeviceAddress());
+    triangleData.setVertexStride(sizeof(vec3));
+    triangleData.setMaxVertex(static_cast<uint32_t>(positions.size()));
+    triangleData.setIndexType(vk::IndexType::eUint32);
+    triangleData.setIndexData(indexBuffer.getDeviceAddress());
+
+    vk::AccelerationStructureGeometryKHR geometry{};
+    geometry.setGeometryType(vk::GeometryTypeKHR::eTriangles);
+    geometry.setGeometry({triangleData});
+    geometry.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
+    return geometry;
+}
+
+void MeshAsset::updateVertices(const std::vector<Vertex>& newVertices) {
+    if (newVertices.size() != positions.size())
+        throw std::runtime_error("updateVertices: vertex count must stay the same (" + std::to_string(positions.size()) + ")");
+
+    setVertices(newVertices);
+    geometryDirty = true;
+    scene.setMeshesDirty();
+    scene.setTlasDirty(); // Instances reference the BLAS, the TLAS has to see its new bounds
+}
+
+void MeshAsset::updateGeometry() {
+    if (bvhRebuildPending) {
+        bvhRebuildPending = false;
+        if (!scene.getContext().isRtxSupported())
+            rebuildBvh();
+    }
+
+    if (!geometryDirty)
+        return;
+    geometryDirty = false;
+
+    Context& context = scene.getContext();
+    positionBuffer.update(context, positions.data(), sizeof(vec3) * positions.size());
+    attributeBuffer.update(context, attributes.data(), sizeof(VertexAttributes) * attributes.size());
+
+    if (context.isRtxSupported()) {
+        // The initial BLAS is built for tracing speed only, the first deformation rebuilds it as updatable.
+        // Updates keep the original topology, so rebuild periodically to recover quality.
+        if (!blasGpu.isUpdatable() || ++blasUpdateCount >= BLAS_REBUILD_INTERVAL) {
+            blasGpu.build(context, createBlasGeometry(), getFaceCount(), vk::AccelerationStructureTypeKHR::eBottomLevel, true);
+            blasUpdateCount = 0;
+        } else {
+            blasGpu.update(context, createBlasGeometry(), getFaceCount());
+        }
+    } else {
+        blasCpu.refit(context);
     }
-    else
-        blasCpu.build(scene.getContext(), this->vertices, this->indices);
 }
 
 uint64_t MeshAsset::getBlasAddress() const {
@@ -259,11 +371,15 @@ uint64_t MeshAsset::getBlasAddress() const {
 
 MeshAddresses MeshAsset::getBufferAddresses() const {
     return MeshAddresses{
-        vertexBuffer.getDeviceAddress(),
+        positionBuffer.getDeviceAddress(),
+        attributeBuffer.getDeviceAddress(),
         indexBuffer.getDeviceAddress(),
-        faceBuffer.getDeviceAddress(),
+        materialRangeBuffer.getDeviceAddress(),
         materialBuffer.getDeviceAddress(),
-        blasCpu.getBufferAddress()
+        blasCpu.getBufferAddress(),
+        blasCpu.getTriangleBufferAddress(),
+        blasCpu.getRopeBufferAddress(),
+        static_cast<uint32_t>(materialRanges.size())
     };
 }
 
@@ -285,6 +401,10 @@ void MeshAsset::renderUi() {
     ImGui::PopItemWidth();
     ImGui::PopStyleColor();
 
+    // The software BVH only exists on the compute path
+    if (!scene.getContext().isRtxSupported())
+        renderBvhUi();
+
     if (materials.empty())
         return;
     
@@ -395,4 +515,78 @@ void MeshAsset::renderUi() {
 void MeshAsset::updateMaterials() {
     materialBuffer = Buffer{scene.getContext(), Buffer::Type::Storage, sizeof(Material) * materials.size(), materials.data()};
     dirty = false; // Reset dirty flag after updating
-}
\ No newline at end of file
+}
+
+void MeshAsset::offsetTextureIndices(const int offset) {
+    if (offset == 0)
+        return;
+
+    for (auto& mat : materials) {
+        for (int* texIndex : {&mat.albedoIndex, &mat.specularIndex, &mat.metallicIndex, &mat.roughnessIndex, &mat.normalIndex,
+                              &mat.emissionIndex, &mat.transmissionIndex, &mat.opacityIndex}) {
+            if (*texIndex >= 0)
+                *texIndex += offset;
+        }
+    }
+    dirty = true;
+}
+
+void MeshAsset::renderBvhUi() {
+    ImGuiManager::tableRowLabel("BVH Builder");
+    int builder = static_cast<int>(bvhOptions.builder);
+    const char* builders[] = {"SAH", "SBVH (spatial splits)", "LBVH (Morton)"};
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    if (ImGui::Combo("##bvhBuilder", &builder, builders, IM_ARRAYSIZE(builders))) {
+        bvhOptions.builder = static_cast<BVH::Builder>(builder);
+        bvhRebuildPending = true;
+        scene.setMeshesDirty();
+    }
+
+    if (bvhOptions.builder == BVH::Builder::SBVH) {
+        ImGuiManager::tableRowLabel("Split Budget");
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::SliderFloat("##bvhSplitBudget", &bvhOptions.spatialSplitBudget, 0.0f, 2.0f, "+%.2fx references");
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            bvhRebuildPending = true;
+            scene.setMeshesDirty();
+        }
+    }
+
+    ImGuiManager::tableRowLabel("Optimize");
+    if (ImGui::Checkbox("Reinsertion##bvhOptimize", &bvhOptions.optimize)) {
+        bvhRebuildPending = true;
+        scene.setMeshesDirty();
+    }
+
+    if (!bvhStatsMeasured) {
+        bvhStats = blasCpu.measureTraversal();
+        bvhStatsMeasured = true;
+    }
+
+    // Previous stats belong to the build before the last builder change
+    auto statsRow = [&](const char* label, const float previous, const float current) {
+        ImGuiManager::tableRowLabel(label);
+        if (previousBvhStats.nodeCount > 0)
+            ImGui::Text("%.2f -> %.2f", previous, current);
+        else
+            ImGui::Text("%.2f", current);
+    };
+    statsRow("SAH Cost", previousBvhStats.sahCost, bvhStats.sahCost);
+    statsRow("Nodes / Ray", previousBvhStats.nodesPerRay, bvhStats.nodesPerRay);
+    statsRow("Triangles / Ray", previousBvhStats.trianglesPerRay, bvhStats.trianglesPerRay);
+    statsRow("Nodes / Ray (stackless)", previousBvhStats.stacklessNodesPerRay, bvhStats.stacklessNodesPerRay);
+    ImGuiManager::tableRowLabel("Nodes / References");
+    ImGui::Text("%zu / %zu", bvhStats.nodeCount, bvhStats.referenceCount);
+    ImGuiManager::tableRowLabel("Wide Nodes");
+    ImGui::Text("%zu (%.2f MB)", bvhStats.wideNodeCount, static_cast<double>(bvhStats.traversalBytes) / (1024.0 * 1024.0));
+
+    if (!bvhOptions.optimize)
+        return;
+    const BVH::OptimizationReport& report = blasCpu.getOptimizationReport();
+    ImGuiManager::tableRowLabel("Reinsertion");
+    if (report.valid)
+        ImGui::Text("%d moves, %.0f ms, SAH %.2f -> %.2f, nodes/ray %.2f -> %.2f", report.reinsertions, report.milliseconds,
+                    report.sahBefore, report.sahAfter, report.nodesPerRayBefore, report.nodesPerRayAfter);
+    else
+        ImGui::TextUnformatted("Loaded from cache");
+}
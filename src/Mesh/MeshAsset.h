@@ -24,6 +24,14 @@ public:
 
     void renderUi() override;
     void updateMaterials();
+    // Replaces the vertex data in place (same count, same topology), e.g. for simulated cloth.
+    // The vertices are split into the position and attribute streams like on construction.
+    // The GPU copy and acceleration structures are updated by updateGeometry() on the next mesh update.
+    void updateVertices(const std::vector<Vertex>& newVertices);
+    // Called by the renderer while the GPU is idle: uploads vertices and refits/updates the BLAS
+    void updateGeometry();
+    // Shifts all material texture indices, used when textures loaded with the mesh are appended to the scene
+    void offsetTextureIndices(int offset);
 
     // Getters & Setters-
     const std::string& getPath() const { return path; }
@@ -32,14 +40,17 @@ public:
     uint32_t getMeshIndex() const;
     void setMeshIndex(uint32_t newIndex);
     
-    const std::vector<Vertex>& getVertices() const { return vertices; }
+    const std::vector<vec3>& getPositions() const { return positions; }
+    const std::vector<VertexAttributes>& getAttributes() const { return attributes; }
     const std::vector<uint32_t>& getIndices() const { return indices; }
-    const std::vector<Face>& getFaces() const { return faces; }
+    const std::vector<MaterialRange>& getMaterialRanges() const { return materialRanges; }
+    uint32_t getFaceCount() const { return static_cast<uint32_t>(indices.size() / 3); }
     const std::vector<Material>& getMaterials() const { return materials; }
 
-    const Buffer& getVertexBuffer() const { return vertexBuffer; }
+    const Buffer& getPositionBuffer() const { return positionBuffer; }
+    const Buffer& getAttributeBuffer() const { return attributeBuffer; }
     const Buffer& getIndexBuffer() const { return indexBuffer; }
-    const Buffer& getFaceBuffer() const { return faceBuffer; }
+    const Buffer& getMaterialRangeBuffer() const { return materialRangeBuffer; }
     const Buffer& getMaterialBuffer() const { return materialBuffer; }
     
     const Accel& getBlasGpu() const { return blasGpu; }
@@ -50,24 +61,41 @@ public:
     void clearDirtyFlag() { dirty = false; }
 
 private:
+    void setVertices(const std::vector<Vertex>& newVertices);
+    // Reorders the triangles by material and builds the ranges that replace the per-face materials
+    void sortFacesByMaterial(const std::vector<Face>& faces);
+    vk::AccelerationStructureGeometryKHR createBlasGeometry() const;
+    void rebuildBvh();
+    void renderBvhUi();
+
     Scene& scene;
     std::string path;
     uint32_t index = -1;
     bool dirty = false;
+    bool geometryDirty = false;
+    uint32_t blasUpdateCount = 0;
+    static constexpr uint32_t BLAS_REBUILD_INTERVAL = 64;
 
-    // CPU-side data
-    std::vector<Vertex> vertices;
+    // CPU-side data, positions are read on their own by intersection and BVH builds
+    std::vector<vec3> positions;
+    std::vector<VertexAttributes> attributes;
     std::vector<uint32_t> indices;
-    std::vector<Face> faces;
+    std::vector<MaterialRange> materialRanges;
     std::vector<Material> materials;
 
     // GPU-side data
-    Buffer vertexBuffer;
+    Buffer positionBuffer;
+    Buffer attributeBuffer;
     Buffer indexBuffer;
-    Buffer faceBuffer;
+    Buffer materialRangeBuffer;
     Buffer materialBuffer;
 
     // Acceleration structures
     Accel blasGpu;
     BVH blasCpu;
+    BVH::BuildOptions bvhOptions;
+    bool bvhRebuildPending = false;
+    BVH::TraversalStats bvhStats;
+    BVH::TraversalStats previousBvhStats;
+    bool bvhStatsMeasured = false; // bvhStats belong to the current BVH
 };
\ No newline at end of file
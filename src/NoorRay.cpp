@@ -1,5 +1,6 @@
-#include "NoorRay.h"
+﻿#include "NoorRay.h"
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <SDL3/SDL.h>
@@ -14,19 +15,32 @@
 #include "backends/imgui_impl_sdl3.h"
 #include "Camera/PerspectiveCamera.h"
 #include "Raytracing/ComputeRaytracer.h"
+#include "Raytracing/DynamicResolution.h"
+#include "Raytracing/SampleScheduler.h"
 #include "Raytracing/RtxRaytracer.h"
 #include "UI/EnvironmentPanel.h"
 #include "UI/RenderPanel.h"
+#include "Vulkan/Denoiser.h"
+#include "Vulkan/GpuProfiler.h"
 #include "Vulkan/Tonemapper.h"
 
-NoorRay::~NoorRay() = default;
+NoorRay::~NoorRay() {
+    // The importer is destroyed after the raytracer and the profiler, a running import must not outlive them
+    sceneImporter.wait();
+    context.setProfiler(nullptr);
+}
 
 NoorRay::NoorRay(const int windowWidth, const int windowHeight, const int renderWidth, const int renderHeight)
     : context(windowWidth, windowHeight),
       renderer(context),
       imGuiManager(context, renderer.getSwapchainImages()),
-      scene(context)
+      scene(context),
+      sceneImporter(scene)
 {
+    // One slot for the compute command buffer and one per graphics frame in flight
+    profiler = std::make_unique<GpuProfiler>(context, 1 + Renderer::MAX_FRAMES_IN_FLIGHT);
+    context.setProfiler(profiler.get());
+
     // Apply DPI scaling for the raytracer
     const float dpiScale = context.getDPIScale();
     int scaledRenderWidth  = static_cast<int>(static_cast<float>(renderWidth)  * dpiScale);
@@ -37,7 +51,8 @@ NoorRay::NoorRay(const int windowWidth, const int windowHeight, const int render
     else
         raytracer = std::make_unique<ComputeRaytracer>(scene, scaledRenderWidth, scaledRenderHeight);
 
-    tonemapper = std::make_unique<Tonemapper>(context, raytracer->getWidth(), raytracer->getHeight(), raytracer->getOutputColor());
+    denoiser = std::make_unique<Denoiser>(context, raytracer->getWidth(), raytracer->getHeight(), raytracer->getOutputColor(), raytracer->getOutputAlbedo(), raytracer->getOutputNormal(), raytracer->getOutputMoments());
+    tonemapper = std::make_unique<Tonemapper>(context, raytracer->getWidth(), raytracer->getHeight(), denoiser->getOutputImage());
 
     setupScene();
     setupUI();
@@ -50,7 +65,15 @@ void NoorRay::run() {
     auto lastTime = clock::now();
     float timeAccumulator = 0.0f;
     int frameCounter = 0;
-    int frame = 0;
+    int frame = 0; // Of the next submission, the convergence mask relies on submitted frames being consecutive
+    bool restartAccumulation = false; // Applied by the next submission
+    CameraData previousCamera{};
+    DynamicResolution dynamicResolution;
+    bool sceneChanged = false; // Since the last submitted frame
+    auto lastSubmitTime = clock::now();
+    SampleScheduler sampleScheduler;
+    PushData lastPush{}; // Of the last submitted frame
+    int sampleOffset = 0;
 
     auto* debugPanel = dynamic_cast<DebugPanel*>(imGuiManager.getComponent("Debug"));
     auto* gpuViewport = dynamic_cast<ViewportPanel*>(imGuiManager.getComponent("Viewport"));
@@ -62,17 +85,58 @@ void NoorRay::run() {
     bool framebufferResized = false;
 
     auto recordComputeCommands = [&](const vk::CommandBuffer cmd) {
+        // Switching resolution leaves the accumulation blocky or stale, it restarts
+        const auto submitTime = clock::now();
+        const int previousStride = dynamicResolution.getPixelStride();
+        const int pixelStride = dynamicResolution.update(sceneChanged, std::chrono::duration<float>(submitTime - lastSubmitTime).count(), renderPanel->getDynamicResolution());
+        if (pixelStride != previousStride || restartAccumulation)
+            frame = 0;
+        restartAccumulation = false;
+        sceneChanged = false;
+        lastSubmitTime = submitTime;
+
+        // The previous submission's fence signaled, so its GPU time is available
+        profiler->beginCommandBuffer(cmd, GpuProfiler::COMPUTE_SLOT);
+        const int samples = renderPanel->getSampleScheduler().enabled
+            ? sampleScheduler.update(profiler->getLastMilliseconds(GpuProfiler::COMPUTE_SLOT, GpuProfiler::RENDER), lastPush.samples, lastPush.pixelStride, pixelStride, renderPanel->getSampleScheduler())
+            : renderPanel->getSamples();
+        if (frame == 0)
+            sampleOffset = 0;
+
         PushConstantsData pushConstantData{};
         pushConstantData.push.frame = frame;
         pushConstantData.push.diffuseBounces = renderPanel->getDiffuseBounces();
         pushConstantData.push.specularBounces = renderPanel->getSpecularBounces();
         pushConstantData.push.transmissionBounces = renderPanel->getTransmissionBounces();
-        pushConstantData.push.samples = renderPanel->getSamples();
+        pushConstantData.push.samples = samples;
+        pushConstantData.push.sampleOffset = sampleOffset;
+        pushConstantData.push.traversalMode = renderPanel->getTraversalMode();
+        pushConstantData.push.rouletteDepth = renderPanel->getRouletteDepth();
+        pushConstantData.push.noiseThreshold = renderPanel->getNoiseThreshold();
+        pushConstantData.push.adaptiveMinFrames = renderPanel->getAdaptiveMinFrames();
+        pushConstantData.push.pixelStride = pixelStride;
         pushConstantData.camera = scene.getActiveCamera()->getCameraData();
         pushConstantData.environment = environment->getEnvironmentData();
 
+        // Compare against the last submitted frame, loop iterations without a submission do not count
+        pushConstantData.push.isMoving = frame > 0 && renderPanel->isReprojectionEnabled() &&
+                                         std::memcmp(&pushConstantData.camera, &previousCamera, sizeof(CameraData)) != 0;
+        pushConstantData.previousCamera = previousCamera;
+        previousCamera = pushConstantData.camera;
+
+        profiler->begin(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::RENDER);
         raytracer->render(cmd, pushConstantData);
+        profiler->end(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::RENDER);
+        lastPush = pushConstantData.push;
+        sampleOffset += samples;
+        ++frame;
+
+        profiler->begin(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::DENOISE);
+        denoiser->dispatch(cmd, renderPanel->getDenoiserSettings());
+        profiler->end(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::DENOISE);
+        profiler->begin(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::TONEMAP);
         tonemapper->dispatch(cmd);
+        profiler->end(cmd, GpuProfiler::COMPUTE_SLOT, GpuProfiler::TONEMAP);
     };
 
     while (isRunning) {
@@ -124,17 +188,21 @@ void NoorRay::run() {
         try {
             imGuiManager.renderUi();
 
+            // Frame boundary: hand over finished background imports
+            sceneImporter.publish();
+
             if (scene.isTlasDirty() || scene.isMeshesDirty() || scene.isTexturesDirty()) {
+                auto sceneLock = scene.shared_lock();
                 renderer.waitForComputeIdle();
                 if (scene.isMeshesDirty()) raytracer->updateMeshes();
                 if (scene.isTexturesDirty()) raytracer->updateTextures();
                 if (scene.isTlasDirty()) raytracer->updateTLAS();
             }
 
-            if (scene.isAccumulationDirty())
-                frame = 0;
-            else
-                frame++;
+            if (scene.isAccumulationDirty() || scene.isCameraDirty())
+                sceneChanged = true;
+            if (scene.isAccumulationDirty() || (scene.isCameraDirty() && !renderPanel->isReprojectionEnabled()))
+                restartAccumulation = true;
             scene.clearDirtyFlags();
 
             bool computeWasSubmitted = false;
@@ -154,8 +222,15 @@ void NoorRay::run() {
                 continue;
             }
 
+            // The frame's fence was waited on in beginFrame, so its slot's last timings are ready
+            const uint32_t profilerSlot = 1 + renderer.getCurrentFrameIndex();
+            profiler->beginCommandBuffer(commandBuffer, profilerSlot);
+            profiler->begin(commandBuffer, profilerSlot, GpuProfiler::VIEWPORT_COPY);
             gpuViewport->recordCopy(commandBuffer, tonemapper->getOutputImage());
+            profiler->end(commandBuffer, profilerSlot, GpuProfiler::VIEWPORT_COPY);
+            profiler->begin(commandBuffer, profilerSlot, GpuProfiler::IMGUI);
             imGuiManager.Draw(commandBuffer, renderer.getCurrentSwapchainImageIndex());
+            profiler->end(commandBuffer, profilerSlot, GpuProfiler::IMGUI);
 
             if (renderer.endFrame(computeWasSubmitted))
                 framebufferResized = true;
@@ -168,12 +243,13 @@ void NoorRay::run() {
         }
     }
 
+    auto queueLock = context.lockQueue();
     context.getDevice().waitIdle();
 }
 
 void NoorRay::setupUI() {
-    imGuiManager.addComponent<MainMenuBar>("Menu", context, scene);
-    imGuiManager.addComponent<DebugPanel>("Debug");
+    imGuiManager.addComponent<MainMenuBar>("Menu", context, scene, sceneImporter);
+    imGuiManager.addComponent<DebugPanel>("Debug", *profiler);
     imGuiManager.addComponent<EnvironmentPanel>("Environment", scene);
     imGuiManager.addComponent<OutlinerDetailsPanel>("Outliner", scene);
     imGuiManager.addComponent<RenderPanel>("Render", context, *raytracer, renderer);
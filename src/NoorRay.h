@@ -2,10 +2,13 @@
 #include "UI/ImGuiManager.h"
 #include <memory>
 #include "Scene/Scene.h"
+#include "Scene/SceneImporter.h"
 #include "Vulkan/Renderer.h"
 
 class GpuRaytracer;
+class Denoiser;
 class Tonemapper;
+class GpuProfiler;
 
 class NoorRay
 {
@@ -13,9 +16,12 @@ class NoorRay
     Renderer renderer;
     ImGuiManager imGuiManager;
     Scene scene;
+    SceneImporter sceneImporter;
 
     std::unique_ptr<GpuRaytracer> raytracer;
+    std::unique_ptr<Denoiser> denoiser;
     std::unique_ptr<Tonemapper> tonemapper;
+    std::unique_ptr<GpuProfiler> profiler;
 
     void setupUI();
     void setupScene();
@@ -3,6 +3,10 @@
 #include "Globals.h"
 #include "Utils.h"
 #include "Scene/MeshInstance.h"
+#include "Camera/PerspectiveCamera.h"
+
+#include <algorithm>
+#include <limits>
 
 ComputeRaytracer::ComputeRaytracer(Scene& scene, uint32_t width, uint32_t height)
     : GpuRaytracer(scene, width, height)
@@ -10,6 +14,9 @@ ComputeRaytracer::ComputeRaytracer(Scene& scene, uint32_t width, uint32_t height
     static constexpr unsigned char ComputeShader[] = {
         #embed "../Shaders/Compute/PathTracer.spv"
     };
+    static constexpr unsigned char OcclusionShader[] = {
+        #embed "../Shaders/Compute/Occlusion.spv"
+    };
 
     vk::UniqueShaderModule computeShaderModule = context.getDevice().createShaderModuleUnique({{}, sizeof(ComputeShader), reinterpret_cast<const uint32_t*>(ComputeShader)});
 
@@ -26,7 +33,13 @@ ComputeRaytracer::ComputeRaytracer(Scene& scene, uint32_t width, uint32_t height
         {3, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // Output normal image
         {4, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // Output crypto  image
         {5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute}, // Mesh buffer
-        {6, vk::DescriptorType::eCombinedImageSampler, MAX_TEXTURES, vk::ShaderStageFlagBits::eCompute}, // Textures
+        {6, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // Luminance moments image
+        {7, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // Tile convergence mask
+        {8, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // History color
+        {9, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // History albedo
+        {10, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // History normal
+        {11, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, // History moments
+        {12, vk::DescriptorType::eCombinedImageSampler, MAX_TEXTURES, vk::ShaderStageFlagBits::eCompute}, // Textures
     };
 
     createDescriptorSet(bindings);
@@ -52,11 +65,39 @@ ComputeRaytracer::ComputeRaytracer(Scene& scene, uint32_t width, uint32_t height
         throw std::runtime_error("failed to create compute pipeline.");
 
     pipeline = std::move(pipelineResult.value);
+
+    // Occlusion queries share the descriptor set and push constant range
+    vk::UniqueShaderModule occlusionShaderModule = context.getDevice().createShaderModuleUnique({{}, sizeof(OcclusionShader), reinterpret_cast<const uint32_t*>(OcclusionShader)});
+    shaderStageInfo.setModule(*occlusionShaderModule);
+    computePipelineInfo.setStage(shaderStageInfo);
+
+    auto occlusionPipelineResult = context.getDevice().createComputePipelineUnique({}, computePipelineInfo);
+    if (occlusionPipelineResult.result != vk::Result::eSuccess)
+        throw std::runtime_error("failed to create occlusion pipeline.");
+
+    occlusionPipeline = std::move(occlusionPipelineResult.value);
     
     bindOutputImages();    
 }
 
 
+namespace {
+
+// Rows of the affine part, the last row of an instance transform is always (0, 0, 0, 1)
+void storeRows(const mat4& matrix, vec4 rows[3])
+{
+    const mat4 transposed = transpose(matrix);
+    for (int r = 0; r < 3; ++r)
+        rows[r] = transposed[r];
+}
+
+// Bounds no ray hits. An inverted box would not do, the slab test orders each axis' distances and would see
+// an infinite box. A box at +infinity gets an entry distance of +infinity, or an exit distance of -infinity
+// when the ray points away on every axis.
+constexpr float UNREACHABLE = std::numeric_limits<float>::infinity();
+
+} // namespace
+
 void ComputeRaytracer::updateTLAS()
 {
     std::vector<ComputeInstance> instances;
@@ -64,20 +105,53 @@ void ComputeRaytracer::updateTLAS()
     const auto& meshInstances = scene.getMeshInstances();
     instances.reserve(meshInstances.size());
 
-    for (const auto* meshInstance : meshInstances)
+    for (uint32_t i = 0; i < meshInstances.size(); ++i)
     {
-        const mat4 transform = meshInstance->getTransform().getMatrix();
-        instances.push_back({
-            .transform = transform,
-            .inverseTransform = inverse(transform),
-            .meshId = meshInstance->getMeshAsset().getMeshIndex()
+        const mat4 transform = meshInstances[i]->getTransform().getMatrix();
+        const MeshAsset& mesh = meshInstances[i]->getMeshAsset();
+
+        // Meshes without triangles have nothing to hit, they are left out. The buffer order is independent of
+        // the scene order anyway, instanceIndex maps back.
+        const AABB localBounds = mesh.getBlasCpu().getBounds();
+        if (localBounds.min.x > localBounds.max.x)
+            continue;
+
+        ComputeInstance& instance = instances.emplace_back();
+        storeRows(transform, instance.objectToWorld);
+        storeRows(inverse(transform), instance.worldToObject);
+        instance.meshId = mesh.getMeshIndex();
+        instance.instanceIndex = i;
+
+        // Center and half extent of the local bounds, the extent maps through the absolute 3x3
+        const vec3 center = vec3(transform * vec4((localBounds.min + localBounds.max) * 0.5f, 1.0f));
+        const vec3 halfExtent = (localBounds.max - localBounds.min) * 0.5f;
+        vec3 worldExtent{0.0f};
+        for (int c = 0; c < 3; ++c)
+            worldExtent += abs(vec3(transform[c])) * halfExtent[c];
+        instance.boundsMin = center - worldExtent;
+        instance.boundsMax = center + worldExtent;
+    }
+
+    // Nearer instances first, so traceScene finds close hits early and culls more of the rest by bestHit.t.
+    // The order only matters for speed and is refreshed whenever the instances change.
+    if (const PerspectiveCamera* camera = scene.getActiveCamera()) {
+        const vec3 eye = camera->getPosition();
+        auto distance = [&](const ComputeInstance& instance) {
+            const vec3 closest = clamp(eye, instance.boundsMin, instance.boundsMax);
+            return dot(closest - eye, closest - eye);
+        };
+        std::stable_sort(instances.begin(), instances.end(), [&](const ComputeInstance& a, const ComputeInstance& b) {
+            return distance(a) < distance(b);
         });
     }
 
     if (instances.empty())
     {
+        // The buffer cannot be empty, the placeholder is culled by its bounds before anything else is read
         auto emptyInstance = ComputeInstance{};
-        emptyInstance.meshId = UINT32_MAX; // invalid instance
+        emptyInstance.meshId = UINT32_MAX;
+        emptyInstance.boundsMin = vec3(UNREACHABLE);
+        emptyInstance.boundsMax = vec3(UNREACHABLE);
         instancesBuffer = Buffer{context, Buffer::Type::Storage, sizeof(ComputeInstance), &emptyInstance};
     }
     else
@@ -96,11 +170,28 @@ void ComputeRaytracer::updateTLAS()
 
 void ComputeRaytracer::render(const vk::CommandBuffer& commandBuffer, const PushConstantsData& pushConstants)
 {
+    // Workgroups match the convergence tiles, so a converged tile costs one mask read
+    resetConvergence(commandBuffer, pushConstants.push);
+    copyHistory(commandBuffer, pushConstants.push);
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline.get());
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout.get(), 0, descriptorSet.get(), {});
     commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstantsData), &pushConstants);
 
-    uint32_t groupCountX = (width + GROUP_SIZE - 1) / GROUP_SIZE;
-    uint32_t groupCountY = (height + GROUP_SIZE - 1) / GROUP_SIZE;
+    uint32_t groupCountX = (getLaunchWidth(pushConstants.push) + GROUP_SIZE - 1) / GROUP_SIZE;
+    uint32_t groupCountY = (getLaunchHeight(pushConstants.push) + GROUP_SIZE - 1) / GROUP_SIZE;
     commandBuffer.dispatch(groupCountX, groupCountY, 1);
 }
+
+void ComputeRaytracer::traceOcclusion(const vk::CommandBuffer& commandBuffer, const vk::DeviceAddress rays, const vk::DeviceAddress results, const uint32_t rayCount, const PushData& push)
+{
+    if (rayCount == 0)
+        return;
+
+    const OcclusionQuery query{.push = push, .rayAddress = rays, .resultAddress = results, .rayCount = rayCount};
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, occlusionPipeline.get());
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout.get(), 0, descriptorSet.get(), {});
+    commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(OcclusionQuery), &query);
+
+    // Matches local_size_x in Occlusion.comp
+    commandBuffer.dispatch((rayCount + 63) / 64, 1, 1);
+}
@@ -3,9 +3,12 @@
 #include "GpuRaytracer.h"
 
 class ComputeRaytracer : public GpuRaytracer {
+    vk::UniquePipeline occlusionPipeline;
+
 public:
     
     void render(const vk::CommandBuffer& commandBuffer, const PushConstantsData& pushConstants) override;
+    void traceOcclusion(const vk::CommandBuffer& commandBuffer, vk::DeviceAddress rays, vk::DeviceAddress results, uint32_t rayCount, const PushData& push) override;
     void updateTLAS() override;
     ComputeRaytracer(Scene& scene, uint32_t width, uint32_t height);
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+﻿#include "DynamicResolution.h"
+#include <algorithm>
+
+int DynamicResolution::update(const bool interacting, float frameTime, const DynamicResolutionSettings& settings) {
+    if (!settings.enabled) {
+        pixelStride = 1;
+        idleTime = 0.0f;
+        return pixelStride;
+    }
+
+    // A stall (loading, window drag) is not representative of the tracing cost
+    frameTime = std::min(frameTime, 1.0f);
+    const float estimate = frameTime * static_cast<float>(pixelStride * pixelStride);
+    fullResolutionFrameTime = fullResolutionFrameTime == 0.0f ? estimate : fullResolutionFrameTime + 0.25f * (estimate - fullResolutionFrameTime);
+
+    idleTime = interacting ? 0.0f : idleTime + frameTime;
+    if (idleTime >= settings.idleDelay) {
+        pixelStride = 1;
+        return pixelStride;
+    }
+    if (!interacting)
+        return pixelStride;
+
+    // Smallest stride that fits the budget, going back to a finer one needs some headroom so it does not flicker
+    int stride = 1;
+    while (stride < MAX_PIXEL_STRIDE && fullResolutionFrameTime / static_cast<float>(stride * stride) > settings.targetFrameTime)
+        ++stride;
+    if (stride > pixelStride || fullResolutionFrameTime / static_cast<float>(stride * stride) < 0.8f * settings.targetFrameTime)
+        pixelStride = stride;
+    return pixelStride;
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+struct DynamicResolutionSettings {
+    bool enabled = false;
+    float targetFrameTime = 1.0f / 30.0f; // Seconds per frame while interacting
+    float idleDelay = 0.5f;               // Seconds without changes before full resolution returns
+};
+
+// Traces fewer pixels while the scene is being edited. The pixel stride follows the measured frame time,
+// full resolution comes back once nothing changed for the idle delay.
+class DynamicResolution {
+public:
+    static constexpr int MAX_PIXEL_STRIDE = 4;
+
+    // Call once per submitted frame. interacting: the scene or camera changed since the previous frame,
+    // frameTime: seconds since the previous frame was submitted. Returns the pixel stride to trace with.
+    int update(bool interacting, float frameTime, const DynamicResolutionSettings& settings);
+    int getPixelStride() const { return pixelStride; }
+
+private:
+    int pixelStride = 1;
+    float idleTime = 0.0f;
+    float fullResolutionFrameTime = 0.0f; // Smoothed estimate, frame time scales with the traced pixel count
+};
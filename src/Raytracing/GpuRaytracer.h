@@ -1,6 +1,9 @@
 ﻿#pragma once
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <utility>
 
 #include "Globals.h"
 #include "Raytracer.h"
@@ -28,7 +31,10 @@ public:
 
     ~GpuRaytracer() override
     {
-        context.getDevice().waitIdle();
+        {
+            auto queueLock = context.lockQueue();
+            context.getDevice().waitIdle();
+        }
         std::cout << "Destroying GpuRaytracer" << std::endl;
     }    
     
@@ -126,9 +132,94 @@ public:
                                    .setDescriptorCount(1)
                                    .setImageInfo(cryptoInfo));
 
+        // Luminance moments (binding = 6)
+        vk::DescriptorImageInfo momentsInfo{};
+        momentsInfo.setImageView(outputMoments.getImageView());
+        momentsInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+        descriptorWrites.push_back(vk::WriteDescriptorSet{}
+                                   .setDstSet(descriptorSet.get())
+                                   .setDstBinding(6)
+                                   .setDescriptorType(vk::DescriptorType::eStorageImage)
+                                   .setDescriptorCount(1)
+                                   .setImageInfo(momentsInfo));
+
+        // Tile convergence mask (binding = 7)
+        vk::DescriptorImageInfo maskInfo{};
+        maskInfo.setImageView(convergenceMask.getImageView());
+        maskInfo.setImageLayout(vk::ImageLayout::eGeneral);
+
+        descriptorWrites.push_back(vk::WriteDescriptorSet{}
+                                   .setDstSet(descriptorSet.get())
+                                   .setDstBinding(7)
+                                   .setDescriptorType(vk::DescriptorType::eStorageImage)
+                                   .setDescriptorCount(1)
+                                   .setImageInfo(maskInfo));
+
+        // Reprojection history, color, albedo, normal and moments (binding = 8 to 11)
+        const Image* historyImages[] = {&historyColor, &historyAlbedo, &historyNormal, &historyMoments};
+        std::array<vk::DescriptorImageInfo, 4> historyInfos;
+        for (uint32_t i = 0; i < historyInfos.size(); ++i) {
+            historyInfos[i].setImageView(historyImages[i]->getImageView());
+            historyInfos[i].setImageLayout(vk::ImageLayout::eGeneral);
+
+            descriptorWrites.push_back(vk::WriteDescriptorSet{}
+                                       .setDstSet(descriptorSet.get())
+                                       .setDstBinding(8 + i)
+                                       .setDescriptorType(vk::DescriptorType::eStorageImage)
+                                       .setDescriptorCount(1)
+                                       .setImageInfo(historyInfos[i]));
+        }
+
         // Update all descriptor sets at once
         context.getDevice().updateDescriptorSets(descriptorWrites, {});
     }
+
+    // Every tile samples again once the accumulation restarts
+    void resetConvergence(const vk::CommandBuffer& commandBuffer, const PushData& push)
+    {
+        if (push.frame != 0)
+            return;
+
+        const vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        commandBuffer.clearColorImage(convergenceMask.getImage(), vk::ImageLayout::eGeneral, vk::ClearColorValue{std::array<uint32_t, 4>{0, 0, 0, 0}}, range);
+
+        vk::MemoryBarrier barrier{vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite};
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, {}, {});
+    }
+
+    // Invocations of the path tracer, one per pixelStride block
+    uint32_t getLaunchWidth(const PushData& push) const
+    {
+        const uint32_t stride = static_cast<uint32_t>(std::max(push.pixelStride, 1));
+        return (width + stride - 1) / stride;
+    }
+
+    uint32_t getLaunchHeight(const PushData& push) const
+    {
+        const uint32_t stride = static_cast<uint32_t>(std::max(push.pixelStride, 1));
+        return (height + stride - 1) / stride;
+    }
+
+    // A moving frame reprojects the previous accumulation while overwriting it in place, so it reads a copy
+    void copyHistory(const vk::CommandBuffer& commandBuffer, const PushData& push)
+    {
+        if (push.isMoving == 0)
+            return;
+
+        vk::MemoryBarrier barrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead};
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, barrier, {}, {});
+
+        const vk::ImageSubresourceLayers layers{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+        const vk::ImageCopy region{layers, {0, 0, 0}, layers, {0, 0, 0}, {width, height, 1}};
+        const std::pair<const Image*, const Image*> copies[] = {
+            {&outputColor, &historyColor}, {&outputAlbedo, &historyAlbedo}, {&outputNormal, &historyNormal}, {&outputMoments, &historyMoments}};
+        for (const auto& [source, destination] : copies)
+            commandBuffer.copyImage(source->getImage(), vk::ImageLayout::eGeneral, destination->getImage(), vk::ImageLayout::eGeneral, region);
+
+        barrier = vk::MemoryBarrier{vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead};
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, {}, {});
+    }
     
     void updateTextures() override
     {
@@ -152,7 +243,7 @@ public:
 
         const vk::WriteDescriptorSet write{
             descriptorSet.get(),
-            6, // DstBinding 6 is for textures
+            12, // DstBinding 12 is for textures
             0,
             descriptorCount,
             vk::DescriptorType::eCombinedImageSampler,
@@ -168,6 +259,7 @@ public:
         meshAddresses.reserve(meshAssets.size());
         for (const auto& meshAsset : meshAssets)
         {
+            meshAsset->updateGeometry();
             meshAsset->updateMaterials();
             meshAddresses.push_back(meshAsset->getBufferAddresses());
         }
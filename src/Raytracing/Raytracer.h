@@ -15,6 +15,13 @@ protected:
     Image outputAlbedo;
     Image outputNormal;
     Image outputCrypto;
+    Image outputMoments; // Luminance mean and second moment, frames accumulated and first hit distance per pixel
+    Image convergenceMask; // Adaptive sampling, one texel per CONVERGENCE_TILE_SIZE tile
+    // Reprojection, the previous accumulation is copied here before a frame in which the camera moved
+    Image historyColor;
+    Image historyAlbedo;
+    Image historyNormal;
+    Image historyMoments;
     
 public:
       Raytracer(Scene& scene, const uint32_t width, const uint32_t height): context(scene.getContext()),
@@ -24,7 +31,14 @@ public:
       outputColor(scene.getContext(), width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst),
       outputAlbedo(scene.getContext(), width, height, vk::Format::eR8G8B8A8Unorm, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst),
       outputNormal(scene.getContext(), width, height, vk::Format::eR16G16B16A16Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst),
-      outputCrypto(scene.getContext(), width, height, vk::Format::eR32Uint, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst)
+      outputCrypto(scene.getContext(), width, height, vk::Format::eR32Uint, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst),
+      outputMoments(scene.getContext(), width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc),
+      convergenceMask(scene.getContext(), (width + CONVERGENCE_TILE_SIZE - 1) / CONVERGENCE_TILE_SIZE, (height + CONVERGENCE_TILE_SIZE - 1) / CONVERGENCE_TILE_SIZE,
+                      vk::Format::eR32Uint, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst),
+      historyColor(scene.getContext(), width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst),
+      historyAlbedo(scene.getContext(), width, height, vk::Format::eR8G8B8A8Unorm, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst),
+      historyNormal(scene.getContext(), width, height, vk::Format::eR16G16B16A16Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst),
+      historyMoments(scene.getContext(), width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst)
     {
     }
 
@@ -37,12 +51,16 @@ public:
     Image& getOutputAlbedo() { return outputAlbedo; }
     Image& getOutputNormal() { return outputNormal; }
     Image& getOutputCrypto() { return outputCrypto; }
+    Image& getOutputMoments() { return outputMoments; }
     
     uint32_t getWidth() const { return width; }
     uint32_t getHeight() const { return height; }
 
     // Pure virtual since implementations differ
     virtual void render(const vk::CommandBuffer& commandBuffer, const PushConstantsData& pushConstants) = 0;
+    // Batch visibility: stores 1 in results[i] if rays[i] hits anything between its tMin and tMax, else 0.
+    // rays and results are device addresses of OcclusionRay and uint32_t arrays with rayCount entries.
+    virtual void traceOcclusion(const vk::CommandBuffer& commandBuffer, vk::DeviceAddress rays, vk::DeviceAddress results, uint32_t rayCount, const PushData& push) = 0;
     virtual void updateTLAS() = 0; 
     virtual void updateTextures() = 0;
     virtual void updateMeshes() = 0;
@@ -13,28 +13,41 @@ RtxRaytracer::RtxRaytracer(Scene& scene, uint32_t width, uint32_t height) : GpuR
     static constexpr unsigned char RayGeneration[] = {
         #embed "../Shaders/RTX/RayGeneration.spv"
     };
+    static constexpr unsigned char OcclusionRayGeneration[] = {
+        #embed "../Shaders/RTX/OcclusionRayGeneration.spv"
+    };
     static constexpr unsigned char PathTracingMiss[] = {
         #embed "../Shaders/RTX/Miss.spv"
     };
+    static constexpr unsigned char ShadowMiss[] = {
+        #embed "../Shaders/RTX/ShadowMiss.spv"
+    };
     static constexpr unsigned char PathTracingClosestHit[] = {
         #embed "../Shaders/RTX/ClosestHit.spv"
     };
 
+    // Group order is raygen, miss, hit. Miss index 1 is used by occlusion rays.
     constexpr const unsigned char* shaders[] = {
         RayGeneration,
+        OcclusionRayGeneration,
         PathTracingMiss,
+        ShadowMiss,
         PathTracingClosestHit,
     };
 
     constexpr size_t shaderSizes[] = {
         sizeof(RayGeneration),
+        sizeof(OcclusionRayGeneration),
         sizeof(PathTracingMiss),
+        sizeof(ShadowMiss),
         sizeof(PathTracingClosestHit),
     };
 
     constexpr vk::ShaderStageFlagBits shaderStages[] = {
+        vk::ShaderStageFlagBits::eRaygenKHR,
         vk::ShaderStageFlagBits::eRaygenKHR,
         vk::ShaderStageFlagBits::eMissKHR,
+        vk::ShaderStageFlagBits::eMissKHR,
         vk::ShaderStageFlagBits::eClosestHitKHR,
     };
 
@@ -78,7 +91,13 @@ RtxRaytracer::RtxRaytracer(Scene& scene, uint32_t width, uint32_t height) : GpuR
         {3, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // Output normal image
         {4, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // Output crypto  image
         {5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eClosestHitKHR}, // Mesh instances buffer
-        {6, vk::DescriptorType::eCombinedImageSampler, MAX_TEXTURES, vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR | vk::ShaderStageFlagBits::eMissKHR}, // Textures
+        {6, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // Luminance moments image
+        {7, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // Tile convergence mask
+        {8, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // History color
+        {9, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // History albedo
+        {10, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // History normal
+        {11, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eRaygenKHR}, // History moments
+        {12, vk::DescriptorType::eCombinedImageSampler, MAX_TEXTURES, vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR | vk::ShaderStageFlagBits::eMissKHR}, // Textures
     };
 
     createDescriptorSet(bindings);
@@ -121,11 +140,14 @@ RtxRaytracer::RtxRaytracer(Scene& scene, uint32_t width, uint32_t height) : GpuR
     uint32_t missSize = missCount * handleSizeAligned;
     uint32_t hitSize = hitCount * handleSizeAligned;
 
-    raygenSBT = Buffer{context, Buffer::Type::ShaderBindingTable, raygenSize, handleStorage.data()};
+    // Every raygen region holds exactly one record, so each raygen shader gets its own table
+    raygenSBT = Buffer{context, Buffer::Type::ShaderBindingTable, handleSizeAligned, handleStorage.data()};
+    occlusionRaygenSBT = Buffer{context, Buffer::Type::ShaderBindingTable, handleSizeAligned, handleStorage.data() + handleSizeAligned};
     missSBT = Buffer{context, Buffer::Type::ShaderBindingTable, missSize, handleStorage.data() + raygenSize};
     hitSBT = Buffer{context, Buffer::Type::ShaderBindingTable, hitSize, handleStorage.data() + raygenSize + missSize};
 
-    raygenRegion = vk::StridedDeviceAddressRegionKHR{raygenSBT.getDeviceAddress(), handleSizeAligned, raygenSize};
+    raygenRegion = vk::StridedDeviceAddressRegionKHR{raygenSBT.getDeviceAddress(), handleSizeAligned, handleSizeAligned};
+    occlusionRaygenRegion = vk::StridedDeviceAddressRegionKHR{occlusionRaygenSBT.getDeviceAddress(), handleSizeAligned, handleSizeAligned};
     missRegion = vk::StridedDeviceAddressRegionKHR{missSBT.getDeviceAddress(), handleSizeAligned, missSize};
     hitRegion = vk::StridedDeviceAddressRegionKHR{hitSBT.getDeviceAddress(), handleSizeAligned, hitSize};
     
@@ -140,8 +162,12 @@ void RtxRaytracer::updateTLAS()
         instances.reserve(meshInstances.size());
         
         for (const auto* meshInstance : meshInstances)
-            if (meshInstance)
-                instances.push_back(meshInstance->getInstanceData());
+            if (meshInstance) {
+                // The BLAS may have been rebuilt since the instance was created
+                auto instance = meshInstance->getInstanceData();
+                instance.setAccelerationStructureReference(meshInstance->getMeshAsset().getBlasAddress());
+                instances.push_back(instance);
+            }
 
         if (instances.empty())
         {
@@ -178,8 +204,22 @@ void RtxRaytracer::updateTLAS()
 
 void RtxRaytracer::render(const vk::CommandBuffer& commandBuffer, const PushConstantsData& pushConstants)
 {
+    resetConvergence(commandBuffer, pushConstants.push);
+    copyHistory(commandBuffer, pushConstants.push);
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline.get());
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipelineLayout.get(), 0, descriptorSet.get(), {});
     commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR | vk::ShaderStageFlagBits::eMissKHR, 0, sizeof(PushConstantsData), &pushConstants);
-    commandBuffer.traceRaysKHR(raygenRegion, missRegion, hitRegion, {}, width, height, 1);
+    commandBuffer.traceRaysKHR(raygenRegion, missRegion, hitRegion, {}, getLaunchWidth(pushConstants.push), getLaunchHeight(pushConstants.push), 1);
+}
+
+void RtxRaytracer::traceOcclusion(const vk::CommandBuffer& commandBuffer, const vk::DeviceAddress rays, const vk::DeviceAddress results, const uint32_t rayCount, const PushData& push)
+{
+    if (rayCount == 0)
+        return;
+
+    const OcclusionQuery query{.push = push, .rayAddress = rays, .resultAddress = results, .rayCount = rayCount};
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline.get());
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipelineLayout.get(), 0, descriptorSet.get(), {});
+    commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR | vk::ShaderStageFlagBits::eMissKHR, 0, sizeof(OcclusionQuery), &query);
+    commandBuffer.traceRaysKHR(occlusionRaygenRegion, missRegion, hitRegion, {}, rayCount, 1, 1);
 }
\ No newline at end of file
@@ -6,10 +6,12 @@
 class RtxRaytracer : public GpuRaytracer {
     Accel tlas;
     Buffer raygenSBT;
+    Buffer occlusionRaygenSBT;
     Buffer missSBT;
     Buffer hitSBT;
     
     vk::StridedDeviceAddressRegionKHR raygenRegion;
+    vk::StridedDeviceAddressRegionKHR occlusionRaygenRegion;
     vk::StridedDeviceAddressRegionKHR missRegion;
     vk::StridedDeviceAddressRegionKHR hitRegion;
 
@@ -17,6 +19,7 @@ public:
     RtxRaytracer(Scene& scene, uint32_t width, uint32_t height);
 
     void render(const vk::CommandBuffer& commandBuffer, const PushConstantsData& pushConstants) override;
+    void traceOcclusion(const vk::CommandBuffer& commandBuffer, vk::DeviceAddress rays, vk::DeviceAddress results, uint32_t rayCount, const PushData& push) override;
 
     void updateTLAS() override;
 };
\ No newline at end of file
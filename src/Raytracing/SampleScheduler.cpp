@@ -0,0 +1,18 @@
+﻿#include "SampleScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+int SampleScheduler::update(const float renderMilliseconds, const int samples, const int pixelStride, const int nextPixelStride, const SampleSchedulerSettings& settings) {
+    if (renderMilliseconds > 0.0f && samples > 0) {
+        const float measured = renderMilliseconds * static_cast<float>(pixelStride * pixelStride) / static_cast<float>(samples);
+        sampleMilliseconds = sampleMilliseconds == 0.0f ? measured : sampleMilliseconds + 0.25f * (measured - sampleMilliseconds);
+    }
+    if (sampleMilliseconds == 0.0f)
+        return scheduledSamples;
+
+    // Growing at most twice per dispatch keeps a wrong estimate from stalling the queue
+    const float nextSampleMilliseconds = sampleMilliseconds / static_cast<float>(nextPixelStride * nextPixelStride);
+    const int fitting = static_cast<int>(std::floor(settings.targetMilliseconds / nextSampleMilliseconds));
+    scheduledSamples = std::clamp(std::min(fitting, scheduledSamples * 2), 1, std::max(settings.maxSamples, 1));
+    return scheduledSamples;
+}
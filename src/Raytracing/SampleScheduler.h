@@ -0,0 +1,20 @@
+﻿#pragma once
+
+struct SampleSchedulerSettings {
+    bool enabled = false;
+    float targetMilliseconds = 16.0f; // GPU time per dispatch, the UI shares the queue with the path tracer
+    int maxSamples = 64;
+};
+
+// Picks the samples per pixel of each dispatch from the measured cost of the previous ones, as many as fit the
+// frame budget. Light scenes get more samples per dispatch, heavy ones keep the UI responsive.
+class SampleScheduler {
+public:
+    // renderMilliseconds: GPU time of the last dispatch, negative if it was not measured.
+    // samples and pixelStride: what that dispatch traced. nextPixelStride: what the next one will trace.
+    int update(float renderMilliseconds, int samples, int pixelStride, int nextPixelStride, const SampleSchedulerSettings& settings);
+
+private:
+    float sampleMilliseconds = 0.0f; // Smoothed cost of one full resolution sample per pixel
+    int scheduledSamples = 1;
+};
@@ -72,6 +72,11 @@ public:
         accumulationDirty.store(true, std::memory_order_relaxed);
     }
 
+    // Camera moved, the accumulation can be reprojected instead of restarted
+    void setCameraDirty() { 
+        cameraDirty.store(true, std::memory_order_relaxed);
+    }
+
     bool isTlasDirty() const { 
         return tlasDirty.load(std::memory_order_relaxed); 
     }
@@ -88,6 +93,10 @@ public:
         return accumulationDirty.load(std::memory_order_relaxed); 
     }
 
+    bool isCameraDirty() const { 
+        return cameraDirty.load(std::memory_order_relaxed); 
+    }
+
     bool isAnyDirty() const {
         return tlasDirty.load(std::memory_order_relaxed) || 
                meshesDirty.load(std::memory_order_relaxed) || 
@@ -99,6 +108,7 @@ public:
         meshesDirty.store(false, std::memory_order_relaxed);
         texturesDirty.store(false, std::memory_order_relaxed);
         accumulationDirty.store(false, std::memory_order_relaxed);
+        cameraDirty.store(false, std::memory_order_relaxed);
     }
 
     void clearAccumulationDirtyFlag() {
@@ -126,4 +136,5 @@ private:
     std::atomic<bool> meshesDirty{false};
     std::atomic<bool> texturesDirty{false};
     std::atomic<bool> accumulationDirty{false};
+    std::atomic<bool> cameraDirty{false};
 };
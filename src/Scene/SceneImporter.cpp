@@ -0,0 +1,133 @@
+﻿#include "SceneImporter.h"
+#include <chrono>
+#include <iostream>
+
+#include "Scene.h"
+#include "MeshInstance.h"
+#include "Mesh/MeshAsset.h"
+#include "Utils.h"
+
+SceneImporter::SceneImporter(Scene& scene) : scene(scene) {}
+
+SceneImporter::~SceneImporter() {
+    wait();
+}
+
+void SceneImporter::wait() {
+    // Parsing cannot be interrupted, so quitting mid-import waits for it
+    if (worker.joinable())
+        worker.join();
+}
+
+bool SceneImporter::start(const std::string& filePath, const Format format) {
+    if (filePath.empty() || busy.load(std::memory_order_acquire))
+        return false;
+
+    if (worker.joinable())
+        worker.join();
+
+    busy.store(true, std::memory_order_release);
+    finished.store(false, std::memory_order_release);
+    setStage("Reading " + Utils::nameFromPath(filePath), 0.0f);
+    worker = std::thread(&SceneImporter::run, this, filePath, format);
+    return true;
+}
+
+std::string SceneImporter::getStatus() const {
+    std::lock_guard lock(statusMutex);
+    return status;
+}
+
+std::string SceneImporter::getReport() const {
+    std::lock_guard lock(statusMutex);
+    return report;
+}
+
+void SceneImporter::setStage(const std::string& newStatus, const float newProgress) {
+    {
+        std::lock_guard lock(statusMutex);
+        status = newStatus;
+    }
+    progress.store(newProgress, std::memory_order_relaxed);
+}
+
+void SceneImporter::run(std::string filePath, const Format format) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    try {
+        if (format == Format::TEXTURE) {
+            resultTextures.emplace_back(scene.getContext(), filePath);
+        } else {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            std::vector<Face> faces;
+            std::vector<Material> materials;
+
+            const auto parseStart = std::chrono::steady_clock::now();
+            switch (format) {
+                case Format::OBJ:
+                    Utils::loadObjParallel(scene, filePath, vertices, indices, faces, materials, &resultTextures);
+                    break;
+                case Format::PLY:
+                    Utils::loadPly(scene, filePath, vertices, indices, faces, materials);
+                    break;
+                case Format::CRTSCENE:
+                    Utils::loadCrtScene(scene, filePath, vertices, indices, faces, materials);
+                    break;
+                default:
+                    break;
+            }
+            const auto parseEnd = std::chrono::steady_clock::now();
+            const size_t triangleCount = faces.size();
+
+            setStage("Building acceleration structure (" + std::to_string(triangleCount) + " triangles)", 0.5f);
+            resultMesh = std::make_shared<MeshAsset>(scene, filePath, std::move(vertices), std::move(indices), std::move(faces), std::move(materials));
+            const auto buildEnd = std::chrono::steady_clock::now();
+
+            // Timings make it easy to compare the OBJ and PLY paths on the same geometry
+            std::lock_guard lock(statusMutex);
+            report = Utils::nameFromPath(filePath) + " (" + std::to_string(triangleCount) + " triangles): parse "
+                   + std::to_string(static_cast<int>(Milliseconds(parseEnd - parseStart).count())) + " ms, upload + acceleration structure "
+                   + std::to_string(static_cast<int>(Milliseconds(buildEnd - parseEnd).count())) + " ms";
+        }
+        setStage("Waiting for frame", 1.0f);
+    } catch (const std::exception& e) {
+        std::cerr << "Import failed: " << e.what() << std::endl;
+        resultTextures.clear();
+        resultMesh.reset();
+        setStage("Import failed", 1.0f);
+    }
+
+    finished.store(true, std::memory_order_release);
+}
+
+bool SceneImporter::publish() {
+    if (!finished.load(std::memory_order_acquire))
+        return false;
+
+    bool published = false;
+    {
+        auto lock = scene.unique_lock();
+
+        // Material texture indices are relative to this import, shift them behind the textures already in the scene
+        const int textureOffset = static_cast<int>(scene.getTextures().size());
+        for (auto& texture : resultTextures)
+            scene.add(std::move(texture));
+        published = !resultTextures.empty();
+
+        if (resultMesh) {
+            resultMesh->offsetTextureIndices(textureOffset);
+            scene.add(resultMesh);
+            auto instance = std::make_unique<MeshInstance>(scene, Utils::nameFromPath(resultMesh->getPath()) + " Instance", resultMesh, Transform{});
+            const int instanceIndex = scene.add(std::move(instance));
+            scene.setActiveObjectIndex(instanceIndex);
+            published = true;
+        }
+    }
+
+    resultTextures.clear();
+    resultMesh.reset();
+    finished.store(false, std::memory_order_release);
+    busy.store(false, std::memory_order_release);
+    return published;
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Vulkan/Texture.h"
+
+class Scene;
+class MeshAsset;
+
+// Runs file imports (parsing, acceleration structure build and upload) on a worker thread.
+// The result is handed to the scene by publish(), which the main loop calls between frames.
+class SceneImporter {
+public:
+    enum class Format {
+        OBJ,
+        PLY,
+        CRTSCENE,
+        TEXTURE
+    };
+
+    explicit SceneImporter(Scene& scene);
+    ~SceneImporter();
+
+    SceneImporter(const SceneImporter&) = delete;
+    SceneImporter& operator=(const SceneImporter&) = delete;
+
+    // Returns false if another import is still running.
+    bool start(const std::string& filePath, Format format);
+
+    // Adds a finished import to the scene under the scene lock. Returns true if anything was published.
+    bool publish();
+
+    // Blocks until a running import has stopped using the context. Its result is still published by publish().
+    void wait();
+
+    bool isBusy() const { return busy.load(std::memory_order_acquire); }
+    float getProgress() const { return progress.load(std::memory_order_relaxed); }
+    std::string getStatus() const;
+    // Parse and build timings of the last finished mesh import, empty before the first one
+    std::string getReport() const;
+
+private:
+    void run(std::string filePath, Format format);
+    void setStage(const std::string& newStatus, float newProgress);
+
+    Scene& scene;
+    std::thread worker;
+
+    std::atomic<bool> busy{false};
+    std::atomic<bool> finished{false};
+    std::atomic<float> progress{0.0f};
+    mutable std::mutex statusMutex;
+    std::string status;
+    std::string report;
+
+    // Written by the worker before finished is set, read by publish() afterwards
+    std::vector<Texture> resultTextures;
+    std::shared_ptr<MeshAsset> resultMesh;
+};
@@ -12,32 +12,32 @@ SceneObject::SceneObject(Scene& scene, std::string  name, const Transform& trans
 
 void SceneObject::setPosition(const glm::vec3& position) {
     transform.setPosition(position);
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::setRotation(const glm::quat& rotation) {
     transform.setRotation(rotation);
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::setRotationEuler(const glm::vec3& rotation) {
     transform.setRotationEuler(rotation);
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::setScale(const glm::vec3& scale) {
     transform.setScale(scale);
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::setTransform(const Transform& transf) {
     transform = transf;
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::setTransformMatrix(const glm::mat4& transf) {
     transform.setFromMatrix(transf);
-    scene.setAccumulationDirty();
+    markTransformDirty();
 }
 
 void SceneObject::renderUi() {
@@ -67,5 +67,9 @@ void SceneObject::renderUi() {
     });
 
     if (anyChanged)
-        scene.setAccumulationDirty();
+        markTransformDirty();
+}
+
+void SceneObject::markTransformDirty() {
+    scene.setAccumulationDirty();
 }
\ No newline at end of file
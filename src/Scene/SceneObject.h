@@ -50,4 +50,8 @@ public:
 
     virtual void setTransform(const Transform& transf);
     virtual void setTransformMatrix(const glm::mat4& transf);
+
+protected:
+    // Called after the transform changed
+    virtual void markTransformDirty();
 };
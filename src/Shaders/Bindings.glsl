@@ -17,14 +17,46 @@ layout (set = 0, binding = 4, r32ui) uniform uimage2D outputCrypto;
 // Binding 2: Mesh Data Pointers (vertex, index, material addresses, etc.)
 layout(set = 0, binding = 5) buffer MeshAddressesBuffer { MeshAddresses meshes[]; };
 
-// Binding 3: Global Texture Sampler Array
-layout(set = 0, binding = 6) uniform sampler2D textureSamplers[];
+// Mean and second moment of the per-frame luminance, frames accumulated and first hit distance (0 for a miss).
+// Adaptive sampling keeps per tile the frame after the last one in which any of its pixels was still noisy,
+// see primaryRayGen
+layout (set = 0, binding = 6, rgba32f) uniform image2D outputMoments;
+layout (set = 0, binding = 7, r32ui) uniform uimage2D convergenceMask;
+
+// Reprojection, copy of the previous accumulation while the camera moves
+layout (set = 0, binding = 8, rgba32f) uniform image2D historyColor;
+layout (set = 0, binding = 9, rgba8) uniform image2D historyAlbedo;
+layout (set = 0, binding = 10, rgba16f) uniform image2D historyNormal;
+layout (set = 0, binding = 11, rgba32f) uniform image2D historyMoments;
+
+// Global Texture Sampler Array, the variable sized binding has to come last
+layout(set = 0, binding = 12) uniform sampler2D textureSamplers[];
 
 // --- Buffer Reference Type Definitions ---
-layout(buffer_reference, scalar) buffer VertexBuffer { Vertex data[]; };
+layout(buffer_reference, scalar) buffer PositionBuffer { vec3 data[]; };
+layout(buffer_reference, scalar) buffer AttributeBuffer { VertexAttributes data[]; };
 layout(buffer_reference, scalar) buffer IndexBuffer { uint data[]; };
-layout(buffer_reference, scalar) buffer FaceBuffer { Face data[]; };
+layout(buffer_reference, scalar) buffer MaterialRangeBuffer { MaterialRange data[]; };
 layout(buffer_reference, scalar) buffer MaterialBuffer { Material data[]; };
-layout(buffer_reference, scalar) buffer BVHBuffer { BVHNode data[]; };
+layout(buffer_reference, scalar) buffer BVHBuffer { WideBVHNode data[]; };
+layout(buffer_reference, scalar) buffer TriangleBuffer { BVHTriangle data[]; };
+layout(buffer_reference, scalar) buffer RopeBuffer { RopeBVHNode data[]; };
+layout(buffer_reference, scalar) buffer OcclusionRayBuffer { OcclusionRay data[]; };
+layout(buffer_reference, scalar) buffer OcclusionResultBuffer { uint data[]; };
+
+// Material of a face, binary search over the material sorted face ranges
+int findMaterialIndex(MeshAddresses mesh, uint face) {
+    MaterialRangeBuffer ranges = MaterialRangeBuffer(mesh.materialRangeAddress);
+    uint low = 0;
+    uint high = mesh.materialRangeCount - 1;
+    while (low < high) {
+        uint middle = (low + high + 1) / 2;
+        if (ranges.data[middle].firstFace <= face)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return ranges.data[low].materialIndex;
+}
 
 #endif
\ No newline at end of file
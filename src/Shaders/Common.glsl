@@ -26,32 +26,13 @@ vec2 interpolateBarycentric(vec3 bary, vec2 p0, vec2 p1, vec2 p2) {
     return p0 * bary.x + p1 * bary.y + p2 * bary.z;
 }
 
-// --- PCG Random Number Generation ---
-uint pcg(inout uint state)
-{
-    uint prev = state * 747796405u + 2891336453u;
-    uint word = ((prev >> ((prev >> 28u) + 4u)) ^ prev) * 277803737u;
-    state = prev;
-    return (word >> 22u) ^ word;
-}
-
-uvec2 pcg2d(uvec2 v)
-{
-    v = v * 1664525u + 1013904223u;
-    v.x += v.y * 1664525u;
-    v.y += v.x * 1664525u;
-    v = v ^ (v >> 16u);
-    v.x += v.y * 1664525u;
-    v.y += v.x * 1664525u;
-    v = v ^ (v >> 16u);
-    return v;
-}
-
-// RNG float in [0,1)
-float rand(inout uint seed)
-{
-    uint val = pcg(seed);
-    return float(val) * (1.0 / 4294967296.0);
+// --- Vertex Attribute Decoding, see VertexAttributes ---
+vec3 decodeOctahedral(uint packed) {
+    vec2 e = unpackSnorm2x16(packed);
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
 }
 
 #endif
\ No newline at end of file
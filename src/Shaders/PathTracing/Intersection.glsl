@@ -1,17 +1,21 @@
 #include "../Bindings.glsl"
 #include "../Common.glsl"
+// Occlusion queries define INTERSECTION_ONLY, they have no payload to shade
+#ifndef INTERSECTION_ONLY
 #include "ShadeMiss.glsl"
 #include "ShadeClosestHit.glsl"
+#endif
 
 // --- Constants ---
 #define EPSILON 1e-5
 #define INF 1.0 / 0.0
-#define MAX_BVH_STACK_DEPTH 128
+// Top of the traversal stack, kept in shared memory. Deeper entries are dropped and found again through the parent links.
+#define SHORT_STACK_SIZE 8
+
+shared int shortStack[gl_WorkGroupSize.x * gl_WorkGroupSize.y * SHORT_STACK_SIZE];
 
 // Ray-Primitive Intersection
-bool intersectTriangle(vec3 rayOrigin, vec3 rayDirection, vec3 v0, vec3 v1, vec3 v2, inout float t, out vec3 bary) {
-    vec3 e1 = v1 - v0;
-    vec3 e2 = v2 - v0;
+bool intersectTriangle(vec3 rayOrigin, vec3 rayDirection, vec3 v0, vec3 e1, vec3 e2, inout float t, out vec3 bary) {
     vec3 pvec = cross(rayDirection, e2);
     float det = dot(e1, pvec);
 
@@ -40,67 +44,212 @@ bool intersectTriangle(vec3 rayOrigin, vec3 rayDirection, vec3 v0, vec3 v1, vec3
 }
 
 // Axis-Aligned Bounding Box (AABB) Intersection
-bool intersectAABB(vec3 rayOrigin, vec3 invDir, vec3 bbox_min, vec3 bbox_max, float t) {
+bool intersectAABB(vec3 rayOrigin, vec3 invDir, vec3 bbox_min, vec3 bbox_max, float t, out float tNear) {
     vec3 tMin = (bbox_min - rayOrigin) * invDir;
     vec3 tMax = (bbox_max - rayOrigin) * invDir;
 
     vec3 t1 = min(tMin, tMax);
     vec3 t2 = max(tMin, tMax);
 
-    float tNear = max(max(t1.x, t1.y), t1.z);
+    tNear = max(max(t1.x, t1.y), t1.z);
     float tFar  = min(min(t2.x, t2.y), t2.z);
 
     return tNear <= tFar && tFar > 0.0f && tNear < t;
 }
 
-// BVH Traversal
-void traverseBVH(vec3 rayOrigin, vec3 rayDirection,  MeshAddresses mesh, inout HitInfo hit) {
+// Instance transforms, see ComputeInstance
+vec3 transformPoint(vec4 rows[3], vec3 p) {
+    return vec3(dot(rows[0], vec4(p, 1.0)), dot(rows[1], vec4(p, 1.0)), dot(rows[2], vec4(p, 1.0)));
+}
+
+vec3 transformVector(vec4 rows[3], vec3 v) {
+    return vec3(dot(rows[0].xyz, v), dot(rows[1].xyz, v), dot(rows[2].xyz, v));
+}
+
+// Multiplies by the transposed upper 3x3, with worldToObject this is the normal matrix
+vec3 transformNormal(vec4 rows[3], vec3 n) {
+    return rows[0].xyz * n.x + rows[1].xyz * n.y + rows[2].xyz * n.z;
+}
+
+// Child bounds are bytes on a power of two grid, see WideBVH.cpp
+vec3 wideNodeStep(WideBVHNode node) {
+    uvec3 exponents = (uvec3(node.exponents) >> uvec3(0, 8, 16)) & 0xFFu;
+    return uintBitsToFloat(exponents << 23);
+}
+
+// Entry and exit distance of a child's box. precise keeps the result the same wherever it is computed,
+// resumeAfterSubtree has to reproduce the order in which traverseBVH visited the children.
+vec2 wideChildInterval(WideBVHNode node, vec3 step, int c, vec3 rayOrigin, vec3 invDir) {
+    uint shift = uint(c) * 8u;
+    vec3 qMin = vec3((uvec3(node.qMin[0], node.qMin[1], node.qMin[2]) >> shift) & 0xFFu);
+    vec3 qMax = vec3((uvec3(node.qMax[0], node.qMax[1], node.qMax[2]) >> shift) & 0xFFu);
+    precise vec3 tMin = (node.origin + qMin * step - rayOrigin) * invDir;
+    precise vec3 tMax = (node.origin + qMax * step - rayOrigin) * invDir;
+    vec3 t1 = min(tMin, tMax);
+    vec3 t2 = max(tMin, tMax);
+    return vec2(max(max(t1.x, t1.y), t1.z), min(min(t2.x, t2.y), t2.z));
+}
+
+// Node that depth first traversal visits after the subtree of nodeIndex is done, -1 at the end. This is the next
+// interior sibling in (entry distance, slot) order that is still in front of tMax, else the one of the closest ancestor.
+int resumeAfterSubtree(BVHBuffer bvh, int nodeIndex, vec3 rayOrigin, vec3 invDir, float tMax) {
+    while (nodeIndex > 0) {
+        int parentIndex = bvh.data[nodeIndex].parent;
+        WideBVHNode parent = bvh.data[parentIndex];
+        vec3 step = wideNodeStep(parent);
+
+        int doneSlot = 0;
+        while (parent.children[doneSlot] != nodeIndex)
+            ++doneSlot;
+        float doneNear = wideChildInterval(parent, step, doneSlot, rayOrigin, invDir).x;
+
+        int next = -1;
+        float nextNear = INF;
+        for (int c = 0; c < WIDE_BVH_WIDTH; ++c) {
+            if (parent.children[c] < 0)
+                continue;
+            vec2 interval = wideChildInterval(parent, step, c, rayOrigin, invDir);
+            if (interval.x > interval.y || interval.y <= 0.0 || interval.x >= tMax)
+                continue;
+            bool after = interval.x > doneNear || (interval.x == doneNear && c > doneSlot);
+            if (after && interval.x < nextNear) {
+                next = parent.children[c];
+                nextNear = interval.x;
+            }
+        }
+        if (next >= 0)
+            return next;
+        nodeIndex = parentIndex;
+    }
+    return -1;
+}
+
+// BVH Traversal, children are visited nearest first. anyHit returns on the first hit closer than hit.t.
+void traverseBVH(vec3 rayOrigin, vec3 rayDirection,  MeshAddresses mesh, inout HitInfo hit, bool anyHit) {
     vec3 invDir = 1.0 / rayDirection;
 
     // Construct buffer references from the 64-bit addresses within the mesh struct.
     BVHBuffer bvh = BVHBuffer(mesh.blasAddress);
-    VertexBuffer vertices = VertexBuffer(mesh.vertexAddress);
-    IndexBuffer indices = IndexBuffer(mesh.indexAddress);
-    int stack[MAX_BVH_STACK_DEPTH];
-    int stackPtr = 0;
-    
-    stack[stackPtr++] = 0; // Start with the root node.
-    while (stackPtr > 0) {
-        int nodeIndex = stack[--stackPtr];
-        BVHNode node = bvh.data[nodeIndex];
-        
-        if (!intersectAABB(rayOrigin, invDir, node.bbox.min, node.bbox.max, hit.t))
+    TriangleBuffer triangles = TriangleBuffer(mesh.triangleAddress);
+
+    // The short stack is a ring, once full its oldest entry is dropped. Dropped entries always come after the kept
+    // ones in visiting order, so when the stack runs empty traversal continues after the subtree it last entered.
+    uint shortBase = gl_LocalInvocationIndex * SHORT_STACK_SIZE;
+    uint shortTop = 0;
+    int shortCount = 0;
+    bool dropped = false;
+    int lastEntered = 0;
+
+    int nodeIndex = 0; // Start with the root node.
+    while (nodeIndex >= 0) {
+        WideBVHNode node = bvh.data[nodeIndex];
+        vec3 step = wideNodeStep(node);
+
+        // Interior children that were hit, sorted by entry distance
+        int nearChildren[WIDE_BVH_WIDTH];
+        float nearDistances[WIDE_BVH_WIDTH];
+        int nearCount = 0;
+
+        for (int c = 0; c < WIDE_BVH_WIDTH; ++c) {
+            int child = node.children[c];
+            if (child == WIDE_BVH_EMPTY)
+                continue;
+
+            vec2 interval = wideChildInterval(node, step, c, rayOrigin, invDir);
+            float tNear = interval.x;
+            if (tNear > interval.y || interval.y <= 0.0 || tNear >= hit.t)
+                continue;
+
+            if (child >= 0) { // Interior node
+                int slot = nearCount++;
+                for (; slot > 0 && nearDistances[slot - 1] > tNear; --slot) {
+                    nearChildren[slot] = nearChildren[slot - 1];
+                    nearDistances[slot] = nearDistances[slot - 1];
+                }
+                nearChildren[slot] = child;
+                nearDistances[slot] = tNear;
+                continue;
+            }
+
+            // Leaf, its triangles are contiguous
+            uint leaf = uint(~child);
+            for (uint i = leaf >> 3; i < (leaf >> 3) + (leaf & 7u); ++i) {
+                BVHTriangle triangle = triangles.data[i];
+                vec3 currentBary;
+                if (intersectTriangle(rayOrigin, rayDirection, triangle.v0, triangle.e1, triangle.e2, hit.t, currentBary)) {
+                    hit.primitiveIndex = int(triangle.primitiveIndex);
+                    hit.barycentrics = currentBary;
+                    if (anyHit)
+                        return;
+                }
+            }
+        }
+
+        // Leaves of this node may have moved the closest hit in front of some children
+        while (nearCount > 0 && nearDistances[nearCount - 1] >= hit.t)
+            --nearCount;
+
+        // Descend into the nearest child right away, push the others farthest first
+        for (int i = nearCount - 1; i > 0; --i) {
+            if (shortCount == SHORT_STACK_SIZE) {
+                dropped = true;
+                --shortCount;
+            }
+            shortStack[shortBase + shortTop] = nearChildren[i];
+            shortTop = (shortTop + 1) % SHORT_STACK_SIZE;
+            ++shortCount;
+        }
+
+        if (nearCount > 0) {
+            nodeIndex = nearChildren[0];
+        } else if (shortCount > 0) {
+            shortTop = (shortTop + SHORT_STACK_SIZE - 1) % SHORT_STACK_SIZE;
+            --shortCount;
+            nodeIndex = shortStack[shortBase + shortTop];
+            lastEntered = nodeIndex;
+        } else if (dropped) {
+            nodeIndex = resumeAfterSubtree(bvh, lastEntered, rayOrigin, invDir, hit.t);
+            lastEntered = nodeIndex;
+        } else {
+            nodeIndex = -1;
+        }
+    }
+}
+
+// Stackless alternative over the depth first rope layout, see RopeBVH.cpp
+void traverseBVHStackless(vec3 rayOrigin, vec3 rayDirection, MeshAddresses mesh, inout HitInfo hit, bool anyHit) {
+    vec3 invDir = 1.0 / rayDirection;
+
+    RopeBuffer ropes = RopeBuffer(mesh.ropeAddress);
+    TriangleBuffer triangles = TriangleBuffer(mesh.triangleAddress);
+
+    int nodeIndex = 0;
+    while (nodeIndex >= 0) {
+        RopeBVHNode node = ropes.data[nodeIndex];
+
+        float tNear;
+        if (!intersectAABB(rayOrigin, invDir, node.min, node.max, hit.t, tNear)) {
+            nodeIndex = node.skip;
             continue;
-        
-        if (node.faceCount > 0) { // Leaf node
-
-            for (int i = 0; i < node.faceCount; ++i) {
-              uint primIdx = uint(node.faceIndices[i]);
-            
-              uint i0 = indices.data[3 * primIdx + 0];
-              uint i1 = indices.data[3 * primIdx + 1];
-              uint i2 = indices.data[3 * primIdx + 2];
-            
-              vec3 v0 = vertices.data[i0].position;
-              vec3 v1 = vertices.data[i1].position;
-              vec3 v2 = vertices.data[i2].position;
-            
-              vec3 currentBary;
-              if (intersectTriangle(rayOrigin, rayDirection, v0, v1, v2, hit.t, currentBary)) {
-                  hit.primitiveIndex = int(primIdx);
-                  hit.barycentrics = currentBary;
-              }
+        }
+
+        if (node.leaf < 0) { // Interior node, the first child follows
+            ++nodeIndex;
+            continue;
+        }
+
+        uint leaf = uint(node.leaf);
+        for (uint i = leaf >> 3; i < (leaf >> 3) + (leaf & 7u); ++i) {
+            BVHTriangle triangle = triangles.data[i];
+            vec3 currentBary;
+            if (intersectTriangle(rayOrigin, rayDirection, triangle.v0, triangle.e1, triangle.e2, hit.t, currentBary)) {
+                hit.primitiveIndex = int(triangle.primitiveIndex);
+                hit.barycentrics = currentBary;
+                if (anyHit)
+                    return;
             }
-        } else { // Interior node
-            if (stackPtr > MAX_BVH_STACK_DEPTH - 2)
-                 continue; // Stack is full, cannot traverse deeper.
-            
-            if (node.leftChild >= 0)
-                stack[stackPtr++] = node.leftChild;
-            
-            if (node.rightChild >= 0)
-                stack[stackPtr++] = node.rightChild;
         }
+        nodeIndex = node.skip;
     }
 }
 
@@ -110,39 +259,70 @@ HitInfo traceScene(vec3 rayOrigin, vec3 rayDirection) {
     bestHit.instanceIndex = -1;
     bestHit.primitiveIndex = -1;
 
+    vec3 invDir = 1.0 / rayDirection;
     for (int i = 0; i < instances.length(); ++i) {
-        ComputeInstance inst = instances[i];
-        if (inst.meshId == 0xFFFFFFFF)
+        // World bounds first, only instances the ray can still hit closer than bestHit are transformed
+        float tNear;
+        if (!intersectAABB(rayOrigin, invDir, instances[i].boundsMin, instances[i].boundsMax, bestHit.t, tNear))
             continue;
 
-        // Transform ray into local space
-        vec3 localOrigin = (inst.inverseTransform * vec4(rayOrigin, 1.0)).xyz;
-        vec3 localDir    = normalize((inst.inverseTransform * vec4(rayDirection, 0.0)).xyz);
+        ComputeInstance inst = instances[i];
+
+        // Transform ray into local space. The direction keeps its scale, so local t is world t.
+        vec3 localOrigin = transformPoint(inst.worldToObject, rayOrigin);
+        vec3 localDir    = transformVector(inst.worldToObject, rayDirection);
 
         HitInfo localHit;
         localHit.t = bestHit.t;   // limit traversal to current best
         localHit.primitiveIndex = -1;
 
         MeshAddresses mesh = meshes[inst.meshId];
-        traverseBVH(localOrigin, localDir, mesh, localHit);
+        if (pushConstants.push.traversalMode == TRAVERSAL_STACKLESS)
+            traverseBVHStackless(localOrigin, localDir, mesh, localHit, false);
+        else
+            traverseBVH(localOrigin, localDir, mesh, localHit, false);
 
+        // Traversal was limited to bestHit.t, any hit is closer
         if (localHit.primitiveIndex != -1) {
-            // Convert hit point back to world space to get correct distance
-            vec3 localPos  = localOrigin + localDir * localHit.t;
-            vec3 worldPos  = (inst.transform * vec4(localPos, 1.0)).xyz;
-            float worldT   = length(worldPos - rayOrigin);
-
-            if (worldT < bestHit.t) {
-                bestHit.t = worldT;
-                bestHit.barycentrics = localHit.barycentrics;
-                bestHit.primitiveIndex = localHit.primitiveIndex;
-                bestHit.instanceIndex = i;
-            }
+            bestHit.t = localHit.t;
+            bestHit.barycentrics = localHit.barycentrics;
+            bestHit.primitiveIndex = localHit.primitiveIndex;
+            bestHit.instanceIndex = i;
         }
     }
     return bestHit;
 }
 
+// True if anything is hit closer than tMax. The direction is not normalized, so t keeps its meaning in every instance.
+bool occludedScene(vec3 rayOrigin, vec3 rayDirection, float tMax) {
+    vec3 invDir = 1.0 / rayDirection;
+    for (int i = 0; i < instances.length(); ++i) {
+        float tNear;
+        if (!intersectAABB(rayOrigin, invDir, instances[i].boundsMin, instances[i].boundsMax, tMax, tNear))
+            continue;
+
+        ComputeInstance inst = instances[i];
+
+        vec3 localOrigin = transformPoint(inst.worldToObject, rayOrigin);
+        vec3 localDir    = transformVector(inst.worldToObject, rayDirection);
+
+        HitInfo localHit;
+        localHit.t = tMax;
+        localHit.primitiveIndex = -1;
+
+        MeshAddresses mesh = meshes[inst.meshId];
+        if (pushConstants.push.traversalMode == TRAVERSAL_STACKLESS)
+            traverseBVHStackless(localOrigin, localDir, mesh, localHit, true);
+        else
+            traverseBVH(localOrigin, localDir, mesh, localHit, true);
+
+        if (localHit.primitiveIndex != -1)
+            return true;
+    }
+    return false;
+}
+
+#ifndef INTERSECTION_ONLY
 void traceRayCompute(vec3 rayOrigin, vec3 rayDirection, inout Payload payload) {
     HitInfo hit = traceScene(rayOrigin, rayDirection);
 
@@ -151,20 +331,23 @@ void traceRayCompute(vec3 rayOrigin, vec3 rayDirection, inout Payload payload) {
     else {
         const ComputeInstance inst = instances[hit.instanceIndex];
         const MeshAddresses mesh = meshes[inst.meshId];
-        const Face face = FaceBuffer(mesh.faceAddress).data[hit.primitiveIndex];
-        const Material material = MaterialBuffer(mesh.materialAddress).data[face.materialIndex];
-        const Vertex v0 = VertexBuffer(mesh.vertexAddress).data[IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 0]];
-        const Vertex v1 = VertexBuffer(mesh.vertexAddress).data[IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 1]];
-        const Vertex v2 = VertexBuffer(mesh.vertexAddress).data[IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 2]];
-        vec3 localPos = interpolateBarycentric(hit.barycentrics, v0.position, v1.position, v2.position);
-        vec3 localNrm = normalize(interpolateBarycentric(hit.barycentrics, v0.normal, v1.normal, v2.normal));
-        vec3 localTan = normalize(interpolateBarycentric(hit.barycentrics, v0.tangent, v1.tangent, v2.tangent));
-        vec2 uv = interpolateBarycentric(hit.barycentrics, v0.uv, v1.uv, v2.uv);
-        vec3 worldPos = (inst.transform * vec4(localPos, 1.0)).xyz;
-        mat3 normalMatrix = transpose(inverse(mat3(inst.transform)));
-        vec3 interpolatedNormal = normalize(normalMatrix * localNrm);
-        vec3 worldTan = normalize(mat3(inst.transform) * localTan);
+        const Material material = MaterialBuffer(mesh.materialAddress).data[findMaterialIndex(mesh, hit.primitiveIndex)];
+        const uint i0 = IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 0];
+        const uint i1 = IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 1];
+        const uint i2 = IndexBuffer(mesh.indexAddress).data[3 * hit.primitiveIndex + 2];
+        const PositionBuffer positions = PositionBuffer(mesh.positionAddress);
+        const VertexAttributes a0 = AttributeBuffer(mesh.attributeAddress).data[i0];
+        const VertexAttributes a1 = AttributeBuffer(mesh.attributeAddress).data[i1];
+        const VertexAttributes a2 = AttributeBuffer(mesh.attributeAddress).data[i2];
+        vec3 localPos = interpolateBarycentric(hit.barycentrics, positions.data[i0], positions.data[i1], positions.data[i2]);
+        vec3 localNrm = normalize(interpolateBarycentric(hit.barycentrics, decodeOctahedral(a0.normal), decodeOctahedral(a1.normal), decodeOctahedral(a2.normal)));
+        vec3 localTan = normalize(interpolateBarycentric(hit.barycentrics, decodeOctahedral(a0.tangent), decodeOctahedral(a1.tangent), decodeOctahedral(a2.tangent)));
+        vec2 uv = interpolateBarycentric(hit.barycentrics, unpackHalf2x16(a0.uv), unpackHalf2x16(a1.uv), unpackHalf2x16(a2.uv));
+        vec3 worldPos = transformPoint(inst.objectToWorld, localPos);
+        vec3 interpolatedNormal = normalize(transformNormal(inst.worldToObject, localNrm));
+        vec3 worldTan = normalize(transformVector(inst.objectToWorld, localTan));
         shadeClosestHit(worldPos, interpolatedNormal, worldTan, uv, rayDirection, material, payload);
-        payload.objectIndex = hit.instanceIndex;
+        payload.objectIndex = int(inst.instanceIndex);
     }
 }
+#endif
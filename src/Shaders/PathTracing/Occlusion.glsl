@@ -0,0 +1,31 @@
+#ifndef OCCLUSION_GLSL
+#define OCCLUSION_GLSL
+
+#ifndef USE_COMPUTE
+// Cleared by RTX/ShadowMiss.glsl
+layout(location = 1) rayPayloadEXT uint occlusionPayload;
+#endif
+
+// True if anything is hit closer than tMax. Stops at the first hit and computes no hit attributes.
+bool occluded(vec3 origin, vec3 direction, float tMax) {
+#ifdef USE_COMPUTE
+    return occludedScene(origin, direction, tMax);
+#else
+    occlusionPayload = 1u;
+    traceRayEXT(topLevelAS, gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT,
+                0xff, 0, 0, 1, origin, 0.00001, direction, tMax, 1);
+    return occlusionPayload != 0u;
+#endif
+}
+
+// Reads the query of this invocation and stores the result
+void traceOcclusionQuery(uint index) {
+    if (index >= pushConstants.rayCount)
+        return;
+
+    OcclusionRay ray = OcclusionRayBuffer(pushConstants.rayAddress).data[index];
+    bool hit = occluded(ray.origin + ray.direction * ray.tMin, ray.direction, ray.tMax - ray.tMin);
+    OcclusionResultBuffer(pushConstants.resultAddress).data[index] = hit ? 1u : 0u;
+}
+
+#endif // OCCLUSION_GLSL
\ No newline at end of file
@@ -28,9 +28,9 @@ vec2 roundBokeh(float u1, float u2, float edgeBias) {
 }
 
 // Generates a primary camera ray for a given pixel, including anti-aliasing and depth of field.
-void generatePrimaryRay(in ivec2 pixelCoord,  in ivec2 screenSize, in CameraData camera, inout uint rngStateX,  inout uint rngStateY,  out vec3 rayOrigin,  out vec3 rayDirection) {
-    // Jitter for anti-aliasing. Each sample gets a random sub-pixel offset.
-    vec2 jitter = vec2(rand(rngStateX), rand(rngStateY)) - 0.5;
+void generatePrimaryRay(in ivec2 pixelCoord,  in ivec2 screenSize, in CameraData camera, inout QmcSampler qmc,  out vec3 rayOrigin,  out vec3 rayDirection) {
+    // Jitter for anti-aliasing. Each sample gets a stratified sub-pixel offset.
+    vec2 jitter = sample2D(qmc) - 0.5;
 
     // Compute normalized UV coordinates with jitter
     vec2 uv = (vec2(pixelCoord) + jitter) / vec2(screenSize);
@@ -57,7 +57,8 @@ void generatePrimaryRay(in ivec2 pixelCoord,  in ivec2 screenSize, in CameraData
     // Apply depth of field if aperture is larger than a pinhole
     if (camera.aperture > 0.0) {
         float apertureRadius = (camera.focalLength / camera.aperture) * 0.5 * 0.001;
-        vec2 lensSample = roundBokeh(rand(rngStateX), rand(rngStateY), camera.bokehBias) * apertureRadius;
+        vec2 lensUV = sample2D(qmc);
+        vec2 lensSample = roundBokeh(lensUV.x, lensUV.y, camera.bokehBias) * apertureRadius;
         vec3 lensU = normalize(horizontal);
         vec3 lensV = normalize(vertical);
         vec3 rayOriginDOF = camPos + lensU * lensSample.x + lensV * lensSample.y;
@@ -68,26 +69,85 @@ void generatePrimaryRay(in ivec2 pixelCoord,  in ivec2 screenSize, in CameraData
     }
 }
 
-void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
-    if (pixelCoord.x >= screenSize.x || pixelCoord.y >= screenSize.y)
+// Relative standard error below which a pixel counts as converged. Dark pixels are measured against a floor
+// so they do not need a near zero error.
+bool isPixelConverged(vec2 moments, float frameCount) {
+    float variance = max(moments.y - moments.x * moments.x, 0.0);
+    float standardError = sqrt(variance / frameCount);
+    return standardError <= pushConstants.push.noiseThreshold * max(moments.x, 0.01);
+}
+
+// Frames a reprojected pixel may carry, each reprojection snaps to the nearest pixel and smears a little
+const float MAX_REPROJECTED_FRAMES = 32.0;
+
+// Pixel of the previous frame that saw the same surface as this pixel's first sample, the inverse of
+// generatePrimaryRay for a pinhole. firstHit.w is 0 for a miss, which reprojects the direction instead and
+// only matches an earlier miss. Hits have to match the previous hit distance and normal, otherwise the
+// surface was disoccluded.
+bool findPreviousPixel(vec4 firstHit, vec3 firstDirection, vec3 normal, ivec2 screenSize, out ivec2 previousPixel) {
+    const CameraData camera = pushConstants.previousCamera;
+    const bool isHit = firstHit.w > 0.0;
+    const vec3 toPoint = isHit ? firstHit.xyz - camera.position : firstDirection;
+    const vec3 forward = normalize(camera.direction);
+    const float depth = dot(toPoint, forward);
+    if (depth <= EPSILON)
+        return false;
+
+    const float focalLength = camera.focalLength * 0.001; // mm to m
+    const vec3 planeOffset = toPoint * (focalLength / depth) - forward * focalLength;
+    vec2 uv = vec2(dot(planeOffset, camera.horizontal) / dot(camera.horizontal, camera.horizontal),
+                   dot(planeOffset, camera.vertical) / dot(camera.vertical, camera.vertical)) + 0.5;
+    uv.y = 1.0 - uv.y;
+    previousPixel = ivec2(floor(uv * vec2(screenSize) + 0.5));
+    if (any(lessThan(previousPixel, ivec2(0))) || any(greaterThanEqual(previousPixel, screenSize)))
+        return false;
+
+    const float previousDistance = imageLoad(historyMoments, previousPixel).w;
+    if (!isHit)
+        return previousDistance == 0.0;
+    if (previousDistance == 0.0 || abs(previousDistance - length(toPoint)) > 0.05 * length(toPoint))
+        return false;
+
+    const vec3 previousNormal = imageLoad(historyNormal, previousPixel).xyz;
+    return dot(previousNormal, normal) > 0.9 * length(previousNormal) * length(normal);
+}
+
+void primaryRayGen(ivec2 launchCoord, ivec2 screenSize) {
+    // Below full resolution an invocation covers a pixelStride sized block, it traces the block's center and
+    // fills the whole block with the result
+    const int pixelStride = max(pushConstants.push.pixelStride, 1);
+    const ivec2 blockOrigin = launchCoord * pixelStride;
+    if (blockOrigin.x >= screenSize.x || blockOrigin.y >= screenSize.y)
+    return;
+    const ivec2 pixelCoord = min(blockOrigin + pixelStride / 2, screenSize - 1);
+
+    // A tile stops once none of its pixels reported noise in the previous frame. The mask is cleared
+    // with the accumulation, and stopped tiles keep what they accumulated so far.
+    const bool adaptive = pushConstants.push.noiseThreshold > 0.0;
+    const ivec2 tile = pixelCoord / CONVERGENCE_TILE_SIZE;
+    if (adaptive && pixelStride == 1 && pushConstants.push.isMoving == 0 && pushConstants.push.frame > pushConstants.push.adaptiveMinFrames &&
+        imageLoad(convergenceMask, tile).r < uint(pushConstants.push.frame))
     return;
 
     #ifdef USE_COMPUTE
         Payload payload;
     #endif
 
-    uvec2 seed = pcg2d(uvec2(pixelCoord) ^ uvec2(pushConstants.push.frame * 16777619));
-    uint rngStateX = seed.x;
-    uint rngStateY = seed.y;
-
     vec3 accumulatedColor = vec3(0.0);
     vec3 accumulatedAlbedo = vec3(0.0);
     vec3 accumulatedNormal = vec3(0.0);
     bool hitAnything = false;
+    vec4 firstHit = vec4(0.0); // First hit position of the first sample, w is 1 if it hit geometry
+    vec3 firstDirection = vec3(0.0);
+    uint objectIndex = 0u;
 
     for (int i = 0; i < pushConstants.push.samples; ++i) {
+        // Samples of a pixel continue across frames, so the accumulated image keeps the sequence's stratification
+        QmcSampler qmc = createSampler(uint(pixelCoord.x), uint(pixelCoord.y), uint(pushConstants.push.sampleOffset + i));
         vec3 rayOrigin, rayDirection;
-        generatePrimaryRay(pixelCoord, screenSize, pushConstants.camera, rngStateX, rngStateY, rayOrigin, rayDirection);
+        generatePrimaryRay(pixelCoord, screenSize, pushConstants.camera, qmc, rayOrigin, rayDirection);
+        if (i == 0)
+            firstDirection = rayDirection;
 
         vec3 throughput = vec3(1.0);
 
@@ -97,7 +157,7 @@ void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
 
         int maxBounces = max(pushConstants.push.diffuseBounces, max(pushConstants.push.specularBounces, pushConstants.push.transmissionBounces));
         for (int bounce = 0; bounce < maxBounces; ++bounce) {
-            payload.rngState = rngStateX;
+            payload.qmc = qmc;
             payload.emission = vec3(0.0);
             payload.attenuation = vec3(1.0);
             payload.depth = bounce;
@@ -111,7 +171,7 @@ void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
             #endif
 
             rayOrigin = payload.position;
-            rngStateX = payload.rngState;
+            qmc = payload.qmc;
 
             if ((payload.flags & BOUNCE_DIFFUSE) != 0u) diffuseCount++;
             if ((payload.flags & BOUNCE_SPECULAR) != 0u) specularCount++;
@@ -122,12 +182,15 @@ void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
 
             // --- Primary Ray / first bounce ---
             if (bounce == 0) {
+                if (i == 0)
+                    firstHit = vec4(payload.position, float(payload.objectIndex >= 0));
+
                 // Accumulate albedo and normal for this sample
                 accumulatedAlbedo += payload.albedo;
                 accumulatedNormal += payload.normal;
 
-                // Store crypto buffer (unchanged)
-                imageStore(outputCrypto, pixelCoord, uvec4(payload.objectIndex, 0, 0, 0));
+                // Crypto buffer, stored with the block below
+                objectIndex = uint(payload.objectIndex);
 
                 // Transparent geometry > skip and continue ray
                 if ((payload.flags & RAY_TRANSPARENT) != 0u) {
@@ -146,9 +209,16 @@ void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
 
             if ((payload.flags & RAY_TERMINATED) != 0u)
             break;
-        }
 
-        rand(rngStateX); // decorrelate RNG
+            // Russian roulette, paths that carry little energy are ended early and the survivors are
+            // weighted up by the survival probability so the estimate stays unbiased
+            if (pushConstants.push.rouletteDepth >= 0 && bounce >= pushConstants.push.rouletteDepth) {
+                float survival = min(max(throughput.r, max(throughput.g, throughput.b)), 0.95);
+                if (sample1D(qmc) >= survival)
+                    break;
+                throughput /= survival;
+            }
+        }
     }
 
     // Average the accumulated values for this frame
@@ -157,30 +227,67 @@ void primaryRayGen(ivec2 pixelCoord, ivec2 screenSize) {
     vec3 newNormal = accumulatedNormal / float(pushConstants.push.samples);
     float newAlpha = float(hitAnything);
 
+    // Previous accumulation of this pixel, a moving camera takes it from where the previous frame saw the same
+    // surface. Pixels without a match start over.
+    vec4 prevColorData = vec4(0.0);
+    vec3 prevAlbedo = vec3(0.0);
+    vec3 prevNormal = vec3(0.0);
+    vec4 prevMoments = vec4(0.0);
+    if (pushConstants.push.frame > 0) {
+        if (pushConstants.push.isMoving != 0) {
+            ivec2 previousPixel;
+            if (findPreviousPixel(firstHit, firstDirection, newNormal, screenSize, previousPixel)) {
+                prevColorData = imageLoad(historyColor, previousPixel);
+                prevAlbedo = imageLoad(historyAlbedo, previousPixel).rgb;
+                prevNormal = imageLoad(historyNormal, previousPixel).rgb;
+                prevMoments = imageLoad(historyMoments, previousPixel);
+                prevMoments.z = min(prevMoments.z, MAX_REPROJECTED_FRAMES);
+            }
+        } else {
+            prevColorData = imageLoad(outputColor, pixelCoord);
+            prevAlbedo = imageLoad(outputAlbedo, pixelCoord).rgb;
+            prevNormal = imageLoad(outputNormal, pixelCoord).rgb;
+            prevMoments = imageLoad(outputMoments, pixelCoord);
+        }
+    }
+    float frameF = prevMoments.z; // Frames accumulated in this pixel
+
     // Accumulate color (existing logic)
     vec3 newColorPremult = newColor * newAlpha;
-    vec4 prevColorData = imageLoad(outputColor, pixelCoord);
     vec3 prevColorPremult = prevColorData.rgb;
     float prevAlpha = prevColorData.a;
-    float frameF = float(pushConstants.push.frame);
 
     vec3 finalColorPremult = (prevColorPremult * frameF + newColorPremult) / (frameF + 1.0);
     float finalAlpha = (prevAlpha * frameF + newAlpha) / (frameF + 1.0);
 
     // Accumulate albedo
-    vec4 prevAlbedoData = imageLoad(outputAlbedo, pixelCoord);
-    vec3 prevAlbedo = prevAlbedoData.rgb;
     vec3 finalAlbedo = (prevAlbedo * frameF + newAlbedo) / (frameF + 1.0);
 
     // Accumulate normal
-    vec4 prevNormalData = imageLoad(outputNormal, pixelCoord);
-    vec3 prevNormal = prevNormalData.rgb;
     vec3 finalNormal = (prevNormal * frameF + newNormal) / (frameF + 1.0);
 
-    // Store the accumulated results
-    imageStore(outputColor, pixelCoord, vec4(finalColorPremult, finalAlpha));
-    imageStore(outputAlbedo, pixelCoord, vec4(finalAlbedo, 1.0));
-    imageStore(outputNormal, pixelCoord, vec4(finalNormal, 0.0));
+    // Luminance moments over frames, the spread of the frame estimates gives the error of their mean
+    const float newLuminance = dot(newColorPremult, vec3(0.2126, 0.7152, 0.0722));
+    vec2 finalMoments = (prevMoments.xy * frameF + vec2(newLuminance, newLuminance * newLuminance)) / (frameF + 1.0);
+    const float hitDistance = firstHit.w > 0.0 ? distance(pushConstants.camera.position, firstHit.xyz) : 0.0;
+    // The global frame check does not cover pixels that reprojection just started over, so each pixel also needs
+    // its own minimum. A single frame has zero variance and would count as converged.
+    if (adaptive && (frameF + 1.0 < float(pushConstants.push.adaptiveMinFrames) || !isPixelConverged(finalMoments, frameF + 1.0)))
+        imageAtomicMax(convergenceMask, tile, uint(pushConstants.push.frame + 1));
+
+    // Store the accumulated results, nearest neighbor upscaled over the block
+    for (int y = 0; y < pixelStride; ++y) {
+        for (int x = 0; x < pixelStride; ++x) {
+            const ivec2 target = blockOrigin + ivec2(x, y);
+            if (target.x >= screenSize.x || target.y >= screenSize.y)
+                continue;
+            imageStore(outputColor, target, vec4(finalColorPremult, finalAlpha));
+            imageStore(outputAlbedo, target, vec4(finalAlbedo, 1.0));
+            imageStore(outputNormal, target, vec4(finalNormal, 0.0));
+            imageStore(outputMoments, target, vec4(finalMoments, frameF + 1.0, hitDistance));
+            imageStore(outputCrypto, target, uvec4(objectIndex, 0, 0, 0));
+        }
+    }
 }
 
 #endif // RAY_GENERATION_GLSL
\ No newline at end of file
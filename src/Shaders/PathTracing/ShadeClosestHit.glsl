@@ -63,9 +63,10 @@ float fresnelDielectric(float cosThetaI, float etaI, float etaT) {
     return 0.5 * (Rs * Rs + Rp * Rp);
 }
 
-vec3 sampleDiffuse(vec3 N, inout uint rngState) {
-    float u1 = rand(rngState);
-    float u2 = rand(rngState);
+vec3 sampleDiffuse(vec3 N, inout QmcSampler qmc) {
+    vec2 u = sample2D(qmc);
+    float u1 = u.x;
+    float u2 = u.y;
     float r = sqrt(u1);
     float theta = 2.0 * PI * u2;
     vec3 local = vec3(r * cos(theta), r * sin(theta), sqrt(max(0.0, 1.0 - u1)));
@@ -85,14 +86,12 @@ vec3 sampleGGXVNDF_local(vec3 Vlocal, float roughness, vec2 u) {
     return normalize(vec3(a * Hstretched.x, a * Hstretched.y, Hstretched.z));
 }
 
-vec3 sampleH(vec3 V, vec3 N, float roughness, inout uint rngState) {
-    float u1 = rand(rngState);
-    float u2 = rand(rngState);
+vec3 sampleH(vec3 V, vec3 N, float roughness, inout QmcSampler qmc) {
     vec3 T, B;
     buildCoordinateSystem(N, T, B);
     mat3 TBN = mat3(T, B, N);
     vec3 Vlocal = transpose(TBN) * V;
-    vec3 Hlocal = sampleGGXVNDF_local(Vlocal, roughness, vec2(u1, u2));
+    vec3 Hlocal = sampleGGXVNDF_local(Vlocal, roughness, sample2D(qmc));
     return TBN * Hlocal;
 }
 
@@ -125,7 +124,7 @@ void handleDielectricBSDF(vec3 viewDir, vec3 shadingNormal, float roughness, flo
     if (dot(Ns_shading, viewDir) < 0.0)
     Ns_shading = -Ns_shading;
 
-    vec3 H = sampleH(viewDir, Ns_shading, roughness, payload.rngState);
+    vec3 H = sampleH(viewDir, Ns_shading, roughness, payload.qmc);
     float VdotH = max(dot(viewDir, H), 0.0);
     vec3 I = normalize(-viewDir);
     float etaI = 1.0, etaT = ior;
@@ -141,7 +140,7 @@ void handleDielectricBSDF(vec3 viewDir, vec3 shadingNormal, float roughness, flo
     vec3 refractedDir = refract(I, H, etaI / etaT);
     bool cannotRefract = length(refractedDir) < 1e-5;
 
-    if (cannotRefract || rand(payload.rngState) < reflectProb) {
+    if (cannotRefract || sample1D(payload.qmc) < reflectProb) {
         vec3 reflectedDir = reflect(-viewDir, H);
         vec3 brdf = evaluateSpecularBRDF(Ns_shading, viewDir, reflectedDir, vec3(reflectProb), roughness, H);
         float pdf = pdfSpecular(viewDir, Ns_shading, H, roughness);
@@ -177,13 +176,13 @@ void handleOpaqueBSDF(vec3 viewDir, vec3 shadingNormal, vec3 albedo, float metal
 
     vec3 sampledDir;
     vec3 H;
-    if (rand(payload.rngState) < probSpecular) {
+    if (sample1D(payload.qmc) < probSpecular) {
         payload.flags |= BOUNCE_SPECULAR;
-        H = sampleH(viewDir, normal, roughness, payload.rngState);
+        H = sampleH(viewDir, normal, roughness, payload.qmc);
         sampledDir = reflect(-viewDir, H);
     } else {
         payload.flags |= BOUNCE_DIFFUSE;
-        sampledDir = sampleDiffuse(normal, payload.rngState);
+        sampledDir = sampleDiffuse(normal, payload.qmc);
         H = normalize(viewDir + sampledDir);
     }
 
@@ -223,7 +222,7 @@ void shadeClosestHit(in vec3 worldPosition, in vec3 interpolatedNormal, in vec3
     if (material.opacityIndex != -1)
         opacity *= texture(textureSamplers[material.opacityIndex], interpolatedUV).a;
 
-    if (rand(payload.rngState) > opacity) {
+    if (sample1D(payload.qmc) > opacity) {
         payload.flags |= RAY_TRANSPARENT;
         return;
     }
@@ -269,7 +268,7 @@ void shadeClosestHit(in vec3 worldPosition, in vec3 interpolatedNormal, in vec3
     payload.normal = shadingNormal * 0.5 + 0.5;
     payload.emission = emission;
 
-    if (rand(payload.rngState) < transmission)
+    if (sample1D(payload.qmc) < transmission)
         handleDielectricBSDF(viewDir, shadingNormal, roughness, material.ior, material.transmissionColor, payload);
     else
         handleOpaqueBSDF(viewDir, shadingNormal, albedo, metallic, specular, roughness, payload);
@@ -17,24 +17,23 @@ hitAttributeEXT vec3 attribs;
 
 void main() {
    const MeshAddresses mesh = meshes[gl_InstanceCustomIndexEXT];
-   VertexBuffer vertexBuf = VertexBuffer(mesh.vertexAddress);
+   PositionBuffer positionBuf = PositionBuffer(mesh.positionAddress);
+   AttributeBuffer attributeBuf = AttributeBuffer(mesh.attributeAddress);
    IndexBuffer indexBuf = IndexBuffer(mesh.indexAddress);
-   FaceBuffer faceBuf = FaceBuffer(mesh.faceAddress);
    MaterialBuffer materialBuf = MaterialBuffer(mesh.materialAddress);
   
-   const Face face = faceBuf.data[gl_PrimitiveID];
-   const Material material = materialBuf.data[face.materialIndex];
+   const Material material = materialBuf.data[findMaterialIndex(mesh, gl_PrimitiveID)];
   
    const uint i0 = indexBuf.data[3 * gl_PrimitiveID + 0];
    const uint i1 = indexBuf.data[3 * gl_PrimitiveID + 1];
    const uint i2 = indexBuf.data[3 * gl_PrimitiveID + 2];
   
-   const Vertex v0 = vertexBuf.data[i0], v1 = vertexBuf.data[i1], v2 = vertexBuf.data[i2];
+   const VertexAttributes a0 = attributeBuf.data[i0], a1 = attributeBuf.data[i1], a2 = attributeBuf.data[i2];
    const vec3 bary = calculateBarycentric(attribs);
-   vec3 localPosition = interpolateBarycentric(bary, v0.position, v1.position, v2.position);
-   vec3 localNormal = normalize(interpolateBarycentric(bary, v0.normal, v1.normal, v2.normal));
-   vec3 localTangent = normalize(interpolateBarycentric(bary, v0.tangent, v1.tangent, v2.tangent));
-   vec2 interpolatedUV = interpolateBarycentric(bary, v0.uv, v1.uv, v2.uv);
+   vec3 localPosition = interpolateBarycentric(bary, positionBuf.data[i0], positionBuf.data[i1], positionBuf.data[i2]);
+   vec3 localNormal = normalize(interpolateBarycentric(bary, decodeOctahedral(a0.normal), decodeOctahedral(a1.normal), decodeOctahedral(a2.normal)));
+   vec3 localTangent = normalize(interpolateBarycentric(bary, decodeOctahedral(a0.tangent), decodeOctahedral(a1.tangent), decodeOctahedral(a2.tangent)));
+   vec2 interpolatedUV = interpolateBarycentric(bary, unpackHalf2x16(a0.uv), unpackHalf2x16(a1.uv), unpackHalf2x16(a2.uv));
   
    vec3 worldPosition = (gl_ObjectToWorldEXT * vec4(localPosition, 1.0)).xyz;
    mat3 normalMatrix = transpose(inverse(mat3(gl_ObjectToWorldEXT)));
@@ -0,0 +1,22 @@
+#version 460
+#pragma shader_stage(raygen)
+
+#extension GL_EXT_ray_tracing: enable
+#extension GL_EXT_nonuniform_qualifier: enable
+#extension GL_EXT_buffer_reference: require
+#extension GL_EXT_scalar_block_layout: enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64: require
+
+#include "../Common.glsl"
+#include "../SharedStructs.h"
+#include "../Bindings.glsl"
+
+layout (push_constant) uniform PushConstants {
+    OcclusionQuery pushConstants;
+};
+
+#include "../PathTracing/Occlusion.glsl"
+
+void main() {
+    traceOcclusionQuery(gl_LaunchIDEXT.x);
+}
\ No newline at end of file
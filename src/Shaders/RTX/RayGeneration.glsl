@@ -21,6 +21,6 @@ layout (location = 0) rayPayloadEXT Payload payload;
 
 void main() {
     const ivec2 pixelCoord = ivec2(gl_LaunchIDEXT.xy);
-    const ivec2 screenSize = ivec2(gl_LaunchSizeEXT.xy);
+    const ivec2 screenSize = imageSize(outputColor); // The launch shrinks below full resolution
     primaryRayGen(pixelCoord, screenSize);
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 460
+#pragma shader_stage(miss)
+
+#extension GL_EXT_ray_tracing : enable
+
+// Miss shader 1, occlusion rays only need to know that nothing was hit
+layout(location = 1) rayPayloadInEXT uint occlusionPayload;
+
+void main()
+{
+    occlusionPayload = 0u;
+}
\ No newline at end of file
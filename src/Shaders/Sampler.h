@@ -0,0 +1,84 @@
+#ifndef _SAMPLER_H_ //include guard, shared by C++ and GLSL
+#define _SAMPLER_H_
+
+#ifdef __cplusplus //In C++, use glm::
+    #pragma once
+    #include <glm/vec2.hpp>
+    #include <glm/integer.hpp>
+    using namespace glm;
+    #define SAMPLER_INLINE inline
+    #define SAMPLER_INOUT(type) type&
+#else
+    #define SAMPLER_INLINE
+    #define SAMPLER_INOUT(type) inout type
+#endif
+
+// Owen scrambled Sobol sampler. Every draw takes the next dimensions of the pixel's sample, the sample index
+// is shuffled per dimension so the dimensions stay uncorrelated (Burley 2020, Practical Hash-based Owen Scrambling).
+struct QmcSampler {
+    uint seed;      // Per pixel
+    uint index;     // Sample of the pixel, PushData::sampleOffset + sample
+    uint dimension; // Next dimension to draw
+    uint _pad0;
+};
+
+SAMPLER_INLINE uint samplerHash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Hash that only lets each bit depend on the bits below it, applied to the reversed value it acts like an Owen scramble
+SAMPLER_INLINE uint nestedUniformScramble(uint x, uint seed) {
+    x = bitfieldReverse(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return bitfieldReverse(x);
+}
+
+// The first Sobol dimension is the bit reversed index, the second one is generated here
+SAMPLER_INLINE uint sobolSecondDimension(uint index) {
+    uint result = 0u;
+    uint direction = 1u << 31;
+    while (index != 0u) {
+        if ((index & 1u) != 0u)
+            result ^= direction;
+        index >>= 1;
+        direction ^= direction >> 1;
+    }
+    return result;
+}
+
+SAMPLER_INLINE QmcSampler createSampler(uint pixelX, uint pixelY, uint sampleIndex) {
+    QmcSampler qmc;
+    qmc.seed = samplerHash(pixelX ^ samplerHash(pixelY));
+    qmc.index = sampleIndex;
+    qmc.dimension = 0u;
+    qmc._pad0 = 0u;
+    return qmc;
+}
+
+SAMPLER_INLINE float sample1D(SAMPLER_INOUT(QmcSampler) qmc) {
+    uint seed = samplerHash(qmc.seed ^ samplerHash(qmc.dimension));
+    qmc.dimension += 1u;
+    uint index = nestedUniformScramble(qmc.index, seed);
+    uint x = nestedUniformScramble(bitfieldReverse(index), samplerHash(seed ^ 0x68bc21ebu));
+    return float(x >> 8) / 16777216.0f;
+}
+
+SAMPLER_INLINE vec2 sample2D(SAMPLER_INOUT(QmcSampler) qmc) {
+    uint seed = samplerHash(qmc.seed ^ samplerHash(qmc.dimension));
+    qmc.dimension += 2u;
+    uint index = nestedUniformScramble(qmc.index, seed);
+    uint x = nestedUniformScramble(bitfieldReverse(index), samplerHash(seed ^ 0x68bc21ebu));
+    uint y = nestedUniformScramble(sobolSecondDimension(index), samplerHash(seed ^ 0x02e5be93u));
+    return vec2(float(x >> 8), float(y >> 8)) / 16777216.0f;
+}
+
+#endif
\ No newline at end of file
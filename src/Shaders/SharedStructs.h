@@ -6,6 +6,8 @@
     using namespace glm;
 #endif
 
+#include "Sampler.h"
+
 #define BVH_MAX_LEAF_SIZE 4
 
 struct AABB {
@@ -35,9 +37,51 @@ struct BVHNode {
 #endif
 };
 
+#define WIDE_BVH_WIDTH 4
+#define WIDE_BVH_EMPTY -1
+
+// Traversal node with four children, child bounds are quantized to 8 bits relative to the node box.
+// A child is a wide node index if >= 0, WIDE_BVH_EMPTY, or ~(firstReference << 3 | count) for leaves.
+struct WideBVHNode {
+    vec3 origin;
+    uint exponents; // Biased float exponent of the quantization step per axis, one byte each
+    uint qMin[3];   // Per axis, one byte per child
+    uint qMax[3];
+    int children[WIDE_BVH_WIDTH];
+    int parent; // Wide node index, -1 for the root. Lets the GPU traversal continue after dropping stack entries.
+};
+
+#define TRAVERSAL_STACK 0
+#define TRAVERSAL_STACKLESS 1
+
+// Depth first node of the stackless layout. The first child of an interior node follows it directly,
+// skip is where traversal continues once the subtree is missed or done, -1 at the end.
+struct RopeBVHNode {
+    vec3 min; int skip;
+    vec3 max; int leaf; // -1 for interior nodes, firstReference << 3 | count for leaves
+};
+
+// Leaf triangle in reference order, only what the intersection test needs.
+// The vertex attributes are read for the closest hit alone.
+struct BVHTriangle {
+    vec3 v0; uint primitiveIndex;
+    vec3 e1; float _pad0; // v1 - v0
+    vec3 e2; float _pad1; // v2 - v0
+};
+
+// Adaptive sampling stops whole tiles of this many pixels squared
+#define CONVERGENCE_TILE_SIZE 8
+
 struct PushData {
     int samples, diffuseBounces, specularBounces, transmissionBounces;
-    int frame, isMoving, _pad0, _pad1;
+    int frame;
+    int isMoving; // Camera moved since the last frame, the accumulation is reprojected from previousCamera
+    int traversalMode;
+    int rouletteDepth; // First bounce that may be ended by Russian roulette, -1 disables it
+    float noiseThreshold; // Relative error at which a tile stops sampling, 0 disables adaptive sampling
+    int adaptiveMinFrames; // Frames every pixel accumulates before its tile may stop
+    int pixelStride; // Traces one pixel per pixelStride x pixelStride block, 1 is full resolution
+    int sampleOffset; // Samples per pixel taken since the accumulation restarted, samples can change every frame
 };
 
 struct EnvironmentData {
@@ -59,12 +103,39 @@ struct CameraData {
     vec3 vertical; float bokehBias;
 };
 
+// Batch visibility queries, see Raytracer::traceOcclusion
+struct OcclusionRay {
+    vec3 origin; float tMin;
+    vec3 direction; float tMax;
+};
+
+// Push constants of the occlusion pipelines, push comes first so the traversal reads the same fields
+struct OcclusionQuery {
+    PushData push;
+    uint64_t rayAddress;    // OcclusionRay per query
+    uint64_t resultAddress; // uint per query, 1 if occluded
+    uint rayCount, _pad0, _pad1, _pad2;
+};
+
 struct PushConstantsData {
     PushData push;
     CameraData camera;
     EnvironmentData environment;
+    CameraData previousCamera;
+};
+
+// Push constants of the denoiser, one dispatch per a-trous iteration
+struct DenoiserPushData {
+    int iteration;      // Filter taps of this pass are 1 << iteration pixels apart
+    int iterationCount; // 0 passes the color through unfiltered
+    int _pad0, _pad1;
+    float colorPhi;     // Luminance edge stop, in standard deviations of the pixel's noise
+    float normalPhi;    // Exponent of the normal edge stop
+    float albedoPhi;    // Albedo difference at which the weight falls to 1/e
+    float _pad2;
 };
 
+// Vertex as produced by the loaders, MeshAsset splits it into the two GPU streams below
 struct Vertex {
     vec3 position; int _pad0;
     vec3 normal; int _pad1;
@@ -72,10 +143,25 @@ struct Vertex {
     vec2 uv; int _pad3, _pad4;
 };
 
+// Shading stream, positions are a separate tightly packed vec3 stream.
+// Normal and tangent are octahedral encoded as two snorm16, uv is two halves.
+struct VertexAttributes {
+    uint normal;
+    uint tangent;
+    uint uv;
+};
+
+// Per-face material as produced by the loaders
 struct Face {
     int materialIndex, _pad0, _pad1, _pad2;
 };
 
+// MeshAsset sorts the faces by material, a range covers its first face up to the next range
+struct MaterialRange {
+    uint firstFace;
+    int materialIndex;
+};
+
 struct Material {
     vec3 albedo; int albedoIndex;
     float specular, metallic, roughness, ior;
@@ -98,11 +184,15 @@ struct Material {
 
 //Vulkan Only
 struct MeshAddresses {
-    uint64_t vertexAddress;
+    uint64_t positionAddress;
+    uint64_t attributeAddress;
     uint64_t indexAddress;
-    uint64_t faceAddress;
+    uint64_t materialRangeAddress;
     uint64_t materialAddress;
     uint64_t blasAddress;
+    uint64_t triangleAddress; // BVHTriangle per leaf reference of the compute BVH
+    uint64_t ropeAddress;
+    uint materialRangeCount, _pad0;
 };
 
 struct Payload {
@@ -110,10 +200,12 @@ struct Payload {
     vec3 emission; int pad0;
     
     vec3 position; uint depth; 
-    vec3 nextDirection; uint rngState;
+    vec3 nextDirection; uint _pad1;
     
     vec3 albedo; float roughness;
     vec3 normal; int objectIndex;
+
+    QmcSampler qmc; // Continues the path's sample dimensions across the trace
 };
 
 
@@ -124,8 +216,11 @@ struct HitInfo {
     vec3 barycentrics;
 };
 
+// Affine transforms as the three rows of a 3x4 matrix. The normal matrix is the transposed
+// upper 3x3 of worldToObject, so it needs no storage of its own.
 struct ComputeInstance {
-    mat4 transform;
-    mat4 inverseTransform;
-    uint meshId, pad1, pad2, pad3; 
+    vec4 objectToWorld[3];
+    vec4 worldToObject[3];
+    vec3 boundsMin; uint meshId; // World space bounds of the mesh
+    vec3 boundsMax; uint instanceIndex; // Index in Scene::getMeshInstances(), the buffer is sorted by distance
 };
\ No newline at end of file
@@ -9,7 +9,11 @@ REM Helper macro to compile shaders and report errors
 call :compile_shader "RTX/RayGeneration.glsl" "RTX/RayGeneration.spv" "--target-env=vulkan1.3"
 call :compile_shader "RTX/ClosestHit.glsl" "RTX/ClosestHit.spv" "--target-env=vulkan1.3"
 call :compile_shader "RTX/Miss.glsl" "RTX/Miss.spv" "--target-env=vulkan1.3"
+call :compile_shader "RTX/OcclusionRayGeneration.glsl" "RTX/OcclusionRayGeneration.spv" "--target-env=vulkan1.3"
+call :compile_shader "RTX/ShadowMiss.glsl" "RTX/ShadowMiss.spv" "--target-env=vulkan1.3"
 call :compile_shader "Compute/PathTracer.comp" "Compute/PathTracer.spv" "-DUSE_COMPUTE=1"
+call :compile_shader "Compute/Occlusion.comp" "Compute/Occlusion.spv" "-DUSE_COMPUTE=1"
+call :compile_shader "Denoising/Denoiser.comp" "Denoising/Denoiser.spv" ""
 call :compile_shader "Tonemapping/Tonemapper.comp" "Tonemapping/Tonemapper.spv" ""
 
 echo Shader compilation complete.
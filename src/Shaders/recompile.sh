@@ -8,9 +8,15 @@ echo "Compiling shaders..."
 $GLSLC RTX/RayGeneration.glsl -o RTX/RayGeneration.spv --target-env=vulkan1.3
 $GLSLC RTX/ClosestHit.glsl -o RTX/ClosestHit.spv --target-env=vulkan1.3
 $GLSLC RTX/Miss.glsl -o RTX/Miss.spv --target-env=vulkan1.3
+$GLSLC RTX/OcclusionRayGeneration.glsl -o RTX/OcclusionRayGeneration.spv --target-env=vulkan1.3
+$GLSLC RTX/ShadowMiss.glsl -o RTX/ShadowMiss.spv --target-env=vulkan1.3
 
 # Compute shader
 $GLSLC Compute/PathTracer.comp -o Compute/PathTracer.spv -DUSE_COMPUTE=1
+$GLSLC Compute/Occlusion.comp -o Compute/Occlusion.spv -DUSE_COMPUTE=1
+
+# Denoiser shader
+$GLSLC Denoising/Denoiser.comp -o Denoising/Denoiser.spv
 
 # Tonemapper shader
 $GLSLC Tonemapping/Tonemapper.comp -o Tonemapping/Tonemapper.spv
@@ -0,0 +1,104 @@
+﻿#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(const uint32_t threadCount) {
+    const uint32_t count = std::max(threadCount, 1u);
+    workers.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex);
+        tasks.push(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(const size_t count, const size_t minRangeSize, const std::function<void(size_t begin, size_t end)>& func) {
+    if (count == 0)
+        return;
+
+    // A few ranges per thread keeps the load balanced when ranges take uneven time.
+    const size_t maxRanges = static_cast<size_t>(getThreadCount()) * 4;
+    const size_t rangeCount = std::clamp<size_t>(count / std::max<size_t>(minRangeSize, 1), 1, maxRanges);
+    if (rangeCount == 1) {
+        func(0, count);
+        return;
+    }
+
+    struct SharedState {
+        std::atomic<size_t> nextRange{0};
+        std::atomic<size_t> finishedRanges{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<SharedState>();
+
+    // Each participant keeps grabbing ranges until none are left.
+    auto runRanges = [state, count, rangeCount, &func] {
+        size_t range;
+        while ((range = state->nextRange.fetch_add(1)) < rangeCount) {
+            const size_t begin = count * range / rangeCount;
+            const size_t end = count * (range + 1) / rangeCount;
+            try {
+                func(begin, end);
+            } catch (...) {
+                std::lock_guard lock(state->mutex);
+                if (!state->error)
+                    state->error = std::current_exception();
+            }
+            if (state->finishedRanges.fetch_add(1) + 1 == rangeCount) {
+                std::lock_guard lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    // Helpers that start after all ranges are taken return immediately, so the reference to func never outlives this call.
+    const size_t helperCount = std::min<size_t>(rangeCount - 1, getThreadCount());
+    for (size_t i = 0; i < helperCount; ++i)
+        enqueue(runRanges);
+
+    runRanges();
+
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&] { return state->finishedRanges.load() == rangeCount; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the CPU-heavy parts of the app (mesh loading, BVH builds).
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool sized to the hardware concurrency.
+    static ThreadPool& get();
+
+    // Splits [0, count) into ranges of at least minRangeSize and runs them on the pool.
+    // The calling thread works on ranges too, so nested calls from inside a worker cannot deadlock.
+    void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t begin, size_t end)>& func);
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
@@ -1,7 +1,8 @@
 ﻿#include "DebugPanel.h"
 #include <imgui.h>
+#include "Vulkan/GpuProfiler.h"
 
-DebugPanel::DebugPanel(std::string name) : ImGuiComponent(std::move(name)) {}
+DebugPanel::DebugPanel(std::string name, GpuProfiler& profiler) : ImGuiComponent(std::move(name)), profiler(profiler) {}
 
 void DebugPanel::renderUi() {
     ImGui::Begin(getType().c_str());
@@ -9,6 +10,31 @@ void DebugPanel::renderUi() {
     // Info section
     ImGui::SeparatorText("Info");
     ImGui::Text("FPS: %.2f", fps);
-    
+
+    // GPU timings over the last samples of each pass
+    ImGui::SeparatorText("GPU Timings (ms)");
+    if (ImGui::BeginTable("GpuTimingsTable", 6, ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("Avg");
+        ImGui::TableSetupColumn("P50");
+        ImGui::TableSetupColumn("P95");
+        ImGui::TableSetupColumn("P99");
+        ImGui::TableSetupColumn("Max");
+        ImGui::TableHeadersRow();
+
+        for (const auto& stats : profiler.getStats()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(stats.name.c_str());
+            for (const float value : {stats.average, stats.median, stats.p95, stats.p99, stats.max}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Export Trace", ImVec2(-FLT_MIN, 0)))
+        profiler.exportTrace("gpu_trace.json");
+
     ImGui::End();
 }
\ No newline at end of file
@@ -3,12 +3,15 @@
 #include "ImGuiComponent.h"
 #include <string>
 
+class GpuProfiler;
+
 class DebugPanel : public ImGuiComponent {
 private:
     float fps = 0.0f;
+    GpuProfiler& profiler;
     
 public:
-    DebugPanel(std::string name);
+    DebugPanel(std::string name, GpuProfiler& profiler);
     
     void renderUi() override;
 
@@ -271,7 +271,11 @@ void ImGuiManager::Draw(const vk::CommandBuffer commandBuffer, const uint32_t im
 
 void ImGuiManager::renderUi()
 {
-    ImGui_ImplVulkan_NewFrame();
+    {
+        // The backend uploads its font texture on the shared queue the first time
+        auto queueLock = context.lockQueue();
+        ImGui_ImplVulkan_NewFrame();
+    }
     ImGui_ImplSDL3_NewFrame();
     ImGui::NewFrame();
 
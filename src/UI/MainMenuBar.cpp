@@ -3,17 +3,19 @@
 #include "portable-file-dialogs.h"
 #include "Utils.h"
 #include "Scene/MeshInstance.h"
+#include "Scene/SceneImporter.h"
 #include <SDL3/SDL.h>
 #include <iostream>
 #include <future>
 
-MainMenuBar::MainMenuBar(std::string name, Context& context, Scene& scene) 
-    : ImGuiComponent(std::move(name)), scene(scene), context(context) {}
+MainMenuBar::MainMenuBar(std::string name, Context& context, Scene& scene, SceneImporter& importer)
+    : ImGuiComponent(std::move(name)), scene(scene), context(context), importer(importer) {}
 
 void MainMenuBar::renderUi() {
     if (ImGui::BeginMainMenuBar()) {
         renderFileMenu();
         renderAddMenu();
+        renderImportProgress();
         ImGui::EndMainMenuBar();
     }
 }
@@ -82,51 +84,34 @@ void MainMenuBar::renderAddMenu() const {
     }
 }
 
-// Function to handle the import logic once a file is selected
+// Hands the selected file to the background importer, the result is added to the scene between frames
 void MainMenuBar::handleFileImport(const std::string& filePath, FileType type) const
 {
     if (filePath.empty()) {
         return;
     }
 
-    try {
-        switch (type) {
-            case FileType::OBJ: {
-                std::vector<Vertex> vertices;
-                std::vector<uint32_t> indices;
-                std::vector<Face> faces;
-                std::vector<Material> materials;
-                Utils::loadObj(scene, filePath, vertices, indices, faces, materials);
-                auto meshAsset = std::make_shared<MeshAsset>(scene, filePath, std::move(vertices), std::move(indices), std::move(faces), std::move(materials));
-                scene.add(meshAsset);
-                auto instance = std::make_unique<MeshInstance>(scene, Utils::nameFromPath(meshAsset->getPath()) + " Instance", meshAsset, Transform{});
-                int instanceIndex = scene.add(std::move(instance));
-                scene.setActiveObjectIndex(instanceIndex);
-                break;
-            }
-            case FileType::CRTSCENE: {
-                std::vector<Vertex> vertices;
-                std::vector<uint32_t> indices;
-                std::vector<Face> faces;
-                std::vector<Material> materials;
-                Utils::loadCrtScene(scene, filePath, vertices, indices, faces, materials);
-                auto meshAsset = std::make_shared<MeshAsset>(scene, filePath, std::move(vertices), std::move(indices), std::move(faces), std::move(materials));
-                scene.add(meshAsset);
-                auto instance = std::make_unique<MeshInstance>(scene, Utils::nameFromPath(meshAsset->getPath()) + " Instance", meshAsset, Transform{});
-                int instanceIndex = scene.add(std::move(instance));
-                scene.setActiveObjectIndex(instanceIndex);
-                break;
-            }
-            case FileType::TEXTURE: {
-                scene.add(Texture(context, filePath));
-                break;
-            }
-            default:
-                break;
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Import failed: " << e.what() << std::endl;
+    SceneImporter::Format format;
+    switch (type) {
+        case FileType::OBJ: format = SceneImporter::Format::OBJ; break;
+        case FileType::PLY: format = SceneImporter::Format::PLY; break;
+        case FileType::CRTSCENE: format = SceneImporter::Format::CRTSCENE; break;
+        case FileType::TEXTURE: format = SceneImporter::Format::TEXTURE; break;
+        default: return;
     }
+
+    if (!importer.start(filePath, format))
+        std::cerr << "Import already in progress, ignoring " << filePath << std::endl;
+}
+
+void MainMenuBar::renderImportProgress() const {
+    if (!importer.isBusy())
+        return;
+
+    const std::string status = importer.getStatus();
+    ImGui::Separator();
+    ImGui::TextUnformatted(status.c_str());
+    ImGui::ProgressBar(importer.getProgress(), ImVec2(160.0f, 0.0f));
 }
 
 void MainMenuBar::renderFileMenu() {
@@ -142,8 +127,8 @@ void MainMenuBar::renderFileMenu() {
         ImGui::Separator();
 
         if (ImGui::BeginMenu("Import")) {
-            // Disable menu items if a dialog is already open
-            ImGui::BeginDisabled(openFuture.valid() && openFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+            // Disable menu items if a dialog is already open or an import is still running
+            ImGui::BeginDisabled(importer.isBusy() || (openFuture.valid() && openFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready));
             
             if (ImGui::MenuItem("Wavefront .obj")) {
                 openFuture = std::async(std::launch::async, [] {
@@ -152,6 +137,13 @@ void MainMenuBar::renderFileMenu() {
                 pendingFileType = FileType::OBJ;
             }
 
+            if (ImGui::MenuItem("Stanford .ply (binary)")) {
+                openFuture = std::async(std::launch::async, [] {
+                    return pfd::open_file("Import PLY Model", ".", { "PLY Files", "*.ply", "All Files", "*" }).result();
+                });
+                pendingFileType = FileType::PLY;
+            }
+
             if (ImGui::MenuItem("Chaos Camp .crtscene")) {
                 openFuture = std::async(std::launch::async, [] {
                     return pfd::open_file("Import CrtScene", ".", { "CRT Scene Files", "*.crtscene", "All Files", "*" }).result();
@@ -167,6 +159,12 @@ void MainMenuBar::renderFileMenu() {
             }
             
             ImGui::EndDisabled();
+
+            const std::string report = importer.getReport();
+            if (!report.empty()) {
+                ImGui::Separator();
+                ImGui::TextDisabled("Last import: %s", report.c_str());
+            }
             ImGui::EndMenu();
         }
 
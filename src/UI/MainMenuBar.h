@@ -7,10 +7,11 @@
 
 class Scene;
 class Context;
+class SceneImporter;
 
 class MainMenuBar : public ImGuiComponent {
 public:
-    MainMenuBar(std::string name, Context& context, Scene& scene);
+    MainMenuBar(std::string name, Context& context, Scene& scene, SceneImporter& importer);
     void renderUi() override;
 
     std::string getType() const override { return "Main Menu"; }
@@ -19,17 +20,20 @@ private:
     // Enum to keep track of the file type for the pending async import.
     enum class FileType {
         OBJ,
+        PLY,
         CRTSCENE,
         TEXTURE
     };
 
     void renderFileMenu();
     void renderAddMenu() const;
+    void renderImportProgress() const;
     void handleFileImport(const std::string& filePath, FileType type) const;
 
     // Member references to core application systems.
     Scene& scene;
     Context& context;
+    SceneImporter& importer;
 
     // Asynchronous file dialog management.
     // openFuture stores the result of the async file dialog.
@@ -97,8 +97,22 @@ void RenderPanel::renderUi() {
         ImGui::TableSetColumnIndex(0);
         ImGui::TextUnformatted("Samples Per Pixel");
         ImGui::TableSetColumnIndex(1);
+        ImGui::BeginDisabled(sampleScheduler.enabled);
         ImGui::SetNextItemWidth(-FLT_MIN);
         ImGui::DragInt("##SamplesDrag", &samples, 0.1f, 1, 64, "%d");
+        ImGui::EndDisabled();
+
+        // Samples per dispatch from the measured GPU time instead, as many as fit the budget
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("GPU Frame Budget");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##SampleScheduler", &sampleScheduler.enabled);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!sampleScheduler.enabled);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragFloat("##SampleSchedulerTarget", &sampleScheduler.targetMilliseconds, 0.1f, 2.0f, 200.0f, "%.1f ms");
+        ImGui::EndDisabled();
 
         // Diffuse Bounces
         ImGui::TableNextRow();
@@ -124,6 +138,101 @@ void RenderPanel::renderUi() {
         ImGui::SetNextItemWidth(-FLT_MIN);
         ImGui::DragInt("##TransmissionBounces", &transmissionBounces, 0.1f, 1, 64, "%d");
 
+        // Russian roulette, paths may end from this bounce on
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Russian Roulette");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##RussianRoulette", &russianRoulette);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!russianRoulette);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragInt("##RouletteDepth", &rouletteDepth, 0.1f, 0, 64, "after %d bounces");
+        ImGui::EndDisabled();
+
+        // Adaptive sampling, tiles stop once their relative error drops below the threshold
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Noise Threshold");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##AdaptiveSampling", &adaptiveSampling);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!adaptiveSampling);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragFloat("##NoiseThreshold", &noiseThreshold, 0.001f, 0.001f, 0.5f, "%.3f");
+        ImGui::EndDisabled();
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Adaptive Min Frames");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::BeginDisabled(!adaptiveSampling);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragInt("##AdaptiveMinFrames", &adaptiveMinFrames, 0.1f, 1, 1024, "%d");
+        ImGui::EndDisabled();
+
+        // Camera moves reproject the accumulation instead of restarting it
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Reprojection");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##Reprojection", &reprojection);
+
+        // Fewer traced pixels while the scene changes, the budget picks how many
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Dynamic Resolution");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##DynamicResolution", &dynamicResolution.enabled);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!dynamicResolution.enabled);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        float targetMilliseconds = dynamicResolution.targetFrameTime * 1000.0f;
+        if (ImGui::DragFloat("##DynamicResolutionTarget", &targetMilliseconds, 0.1f, 4.0f, 200.0f, "%.1f ms"))
+            dynamicResolution.targetFrameTime = targetMilliseconds * 0.001f;
+        ImGui::EndDisabled();
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Full Resolution After");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::BeginDisabled(!dynamicResolution.enabled);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragFloat("##DynamicResolutionIdle", &dynamicResolution.idleDelay, 0.01f, 0.0f, 5.0f, "%.2f s idle");
+        ImGui::EndDisabled();
+
+        // Edge-avoiding a-trous filter of the viewport, saved passes stay unfiltered
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Denoiser");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Checkbox("##Denoise", &denoise);
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!denoise);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragInt("##DenoiserIterations", &denoiserIterations, 0.05f, 1, 5, "%d iterations");
+        ImGui::EndDisabled();
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::TextUnformatted("Denoiser Strength");
+        ImGui::TableSetColumnIndex(1);
+        ImGui::BeginDisabled(!denoise);
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        ImGui::DragFloat("##DenoiserColorPhi", &denoiserColorPhi, 0.05f, 0.5f, 32.0f, "%.2f");
+        ImGui::EndDisabled();
+
+        // BVH traversal kernel of the compute backend
+        if (!context.isRtxSupported()) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted("BVH Traversal");
+            ImGui::TableSetColumnIndex(1);
+            ImGui::SetNextItemWidth(-FLT_MIN);
+            const char* traversalModes[] = {"Stack (nearest first)", "Stackless (skip links)"};
+            ImGui::Combo("##TraversalMode", &traversalMode, traversalModes, IM_ARRAYSIZE(traversalModes));
+        }
+
         ImGui::EndTable();
     }
     
@@ -206,6 +315,15 @@ void RenderPanel::renderUi() {
     ImGui::End();
 }
 
+DenoiserPushData RenderPanel::getDenoiserSettings() const {
+    DenoiserPushData settings{};
+    settings.iterationCount = denoise ? denoiserIterations : 0;
+    settings.colorPhi = denoiserColorPhi;
+    settings.normalPhi = 128.0f;
+    settings.albedoPhi = 0.1f;
+    return settings;
+}
+
 void RenderPanel::executeSave() {
     if (m_saveState != SaveState::IDLE) {
         std::cout << "Save operation already in progress." << std::endl;
@@ -1,6 +1,9 @@
 ﻿#pragma once
 #include "UI/ImGuiComponent.h"
 #include "Vulkan/Buffer.h"
+#include "Shaders/SharedStructs.h"
+#include "Raytracing/DynamicResolution.h"
+#include "Raytracing/SampleScheduler.h"
 #include <string>
 #include <future>
 #include <vector>
@@ -26,9 +29,29 @@ public:
     int getDiffuseBounces() const { return diffuseBounces; }
     int getSpecularBounces() const { return specularBounces; }
     int getTransmissionBounces() const { return transmissionBounces; }
+    int getTraversalMode() const { return traversalMode; }
+    int getRouletteDepth() const { return russianRoulette ? rouletteDepth : -1; }
+    float getNoiseThreshold() const { return adaptiveSampling ? noiseThreshold : 0.0f; }
+    int getAdaptiveMinFrames() const { return adaptiveMinFrames; }
+    DenoiserPushData getDenoiserSettings() const;
+    bool isReprojectionEnabled() const { return reprojection; }
+    const DynamicResolutionSettings& getDynamicResolution() const { return dynamicResolution; }
+    const SampleSchedulerSettings& getSampleScheduler() const { return sampleScheduler; }
     
 private:
     int samples, diffuseBounces, specularBounces, transmissionBounces;
+    int traversalMode = TRAVERSAL_STACK;
+    bool russianRoulette = true;
+    int rouletteDepth = 3;
+    bool adaptiveSampling = false;
+    float noiseThreshold = 0.02f;
+    int adaptiveMinFrames = 16;
+    bool reprojection = false;
+    DynamicResolutionSettings dynamicResolution;
+    SampleSchedulerSettings sampleScheduler;
+    bool denoise = false;
+    int denoiserIterations = 4;
+    float denoiserColorPhi = 4.0f;
     
     // State machine for the save process
     enum class SaveState {
@@ -1,4 +1,10 @@
-﻿#include <cmath>
+﻿#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
 #include <fstream>
 #include <stdexcept>
 #include "Utils.h"
@@ -19,6 +25,417 @@
 
 #include "glm/gtx/norm.hpp"
 
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+std::string directoryOf(const std::string& filepath) {
+    const size_t lastSlash = filepath.find_last_of("/\\");
+    return (lastSlash != std::string::npos) ? filepath.substr(0, lastSlash) : ".";
+}
+
+// Shared by both OBJ loaders so they produce identical materials and textures.
+// With pendingTextures set, textures are collected there instead of the scene and indexed relative to that list.
+void convertObjMaterials(Scene& scene, const std::vector<tinyobj::material_t>& mats, const std::string& objDir, std::vector<Material>& materials, std::vector<Texture>* pendingTextures) {
+    materials.clear();
+    for (const auto& mat : mats) {
+        Material material{};
+        material.albedo = vec3(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2]);
+        material.specular = mat.specular[0];
+        material.metallic = mat.metallic;
+        material.roughness = mat.roughness;
+        material.ior = mat.ior;
+        material.transmissionColor = vec3(mat.transmittance[0], mat.transmittance[1], mat.transmittance[2]);
+        material.transmission = (mat.illum == 4 || mat.illum == 7) ? 1.0f : 0.0f;
+        material.opacity = mat.dissolve;
+        material.emission = vec3(mat.emission[0], mat.emission[1], mat.emission[2]);
+        material.emissionStrength = (material.emission != vec3(0.0f)) ? 1.0f : 0.0f;
+
+        auto addTexture = [&](const std::string& texname, int& index) {
+            if (!texname.empty()) {
+                std::string texturePath = objDir + "/" + texname;
+                if (std::filesystem::exists(texturePath)) {
+                    if (pendingTextures) {
+                        pendingTextures->emplace_back(scene.getContext(), texturePath);
+                        index = static_cast<int>(pendingTextures->size() - 1);
+                    } else {
+                        scene.add(Texture(scene.getContext(), texturePath));
+                        index = static_cast<int>(scene.getTextures().size() - 1);
+                    }
+                } else
+                    std::cerr << "Warning: Texture file not found: " << texturePath << std::endl;
+            }
+        };
+
+        addTexture(mat.diffuse_texname, material.albedoIndex);
+        addTexture(mat.specular_texname, material.specularIndex);
+        addTexture(mat.roughness_texname, material.roughnessIndex);
+        addTexture(mat.normal_texname, material.normalIndex);
+        addTexture(mat.alpha_texname, material.opacityIndex);
+        addTexture(mat.emissive_texname, material.emissionIndex);
+
+        materials.push_back(material);
+    }
+}
+
+vec3 computeTangent(const Vertex& v0, const Vertex& v1, const Vertex& v2) {
+    const vec3 edge1 = v1.position - v0.position;
+    const vec3 edge2 = v2.position - v0.position;
+    const vec2 deltaUV1 = v1.uv - v0.uv;
+    const vec2 deltaUV2 = v2.uv - v0.uv;
+
+    float f = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+    if (std::fabs(f) < 1e-8f)
+        return vec3(1.0f, 0.0f, 0.0f); // Degenerate UV, pick arbitrary tangent
+
+    f = 1.0f / f;
+    const vec3 tangent = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+    return length2(tangent) > 1e-8f ? normalize(tangent) : vec3(1.0f, 0.0f, 0.0f);
+}
+
+// ---- Parallel OBJ parsing ----
+
+// Corner of a triangle as written in the file. Relative (negative) indices are stored
+// relative to the start of the chunk and resolved once all chunk sizes are known.
+struct ObjCorner {
+    int32_t position, texcoord, normal;
+    uint32_t flags;
+};
+
+constexpr uint32_t OBJ_POSITION_RELATIVE = 1u << 0;
+constexpr uint32_t OBJ_TEXCOORD_RELATIVE = 1u << 1;
+constexpr uint32_t OBJ_NORMAL_RELATIVE = 1u << 2;
+constexpr uint32_t OBJ_HAS_TEXCOORD = 1u << 3;
+constexpr uint32_t OBJ_HAS_NORMAL = 1u << 4;
+
+struct ObjChunk {
+    std::vector<float> positions; // xyz
+    std::vector<float> normals;   // xyz
+    std::vector<float> texcoords; // uv
+    std::vector<ObjCorner> corners; // 3 per triangle
+    std::vector<std::pair<uint32_t, std::string>> materialSwitches; // first local triangle, material name
+    std::vector<std::string> materialLibraries;
+};
+
+bool isSpace(const char c) { return c == ' ' || c == '\t'; }
+
+void skipSpaces(const char*& p, const char* end) {
+    while (p < end && isSpace(*p))
+        ++p;
+}
+
+// Locale independent float parsing; std::from_chars for floats is not available on every standard library we target.
+float parseFloat(const char*& p, const char* end) {
+    static constexpr double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    skipSpaces(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool anyDigits = false;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) ++digits; }
+        else ++exponent;
+        ++p;
+        anyDigits = true;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) ++digits; --exponent; }
+            ++p;
+            anyDigits = true;
+        }
+    }
+    if (!anyDigits) {
+        // Rare spellings such as "nan" or "inf"
+        char* strtodEnd = nullptr;
+        const std::string token(start, std::find_if(start, end, [](char c) { return isSpace(c) || c == '\n' || c == '\r'; }));
+        const float value = std::strtof(token.c_str(), &strtodEnd);
+        p = start + (strtodEnd - token.c_str());
+        return value;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (e < 10000) e = e * 10 + (*p - '0');
+            ++p;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        while (exponent < -22) { value /= 1e22; exponent += 22; }
+        value /= powersOf10[-exponent];
+    } else {
+        while (exponent > 22) { value *= 1e22; exponent -= 22; }
+        value *= powersOf10[exponent];
+    }
+    return static_cast<float>(negative ? -value : value);
+}
+
+bool parseInt(const char*& p, const char* end, int32_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p >= end || *p < '0' || *p > '9')
+        return false;
+    int64_t result = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        result = std::min<int64_t>(result * 10 + (*p++ - '0'), INT32_MAX);
+    value = static_cast<int32_t>(negative ? -result : result);
+    return true;
+}
+
+// Turns a 1-based or negative OBJ index into a chunk encoded value, see ObjCorner.
+bool encodeIndex(int32_t index, size_t localCount, int32_t& encoded, uint32_t& flags, uint32_t relativeFlag) {
+    if (index > 0) {
+        encoded = index - 1;
+        return true;
+    }
+    if (index < 0) {
+        encoded = static_cast<int32_t>(localCount) + index;
+        flags |= relativeFlag;
+        return true;
+    }
+    return false;
+}
+
+std::string_view restOfLine(const char* p, const char* end) {
+    skipSpaces(p, end);
+    const char* lineEnd = p;
+    while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r')
+        ++lineEnd;
+    while (lineEnd > p && isSpace(lineEnd[-1]))
+        --lineEnd;
+    return {p, static_cast<size_t>(lineEnd - p)};
+}
+
+void parseObjChunk(const char* p, const char* end, ObjChunk& chunk) {
+    std::vector<ObjCorner> polygon;
+    while (p < end) {
+        skipSpaces(p, end);
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+
+        if (p + 1 < lineEnd) {
+            if (p[0] == 'v' && isSpace(p[1])) {
+                p += 2;
+                for (int i = 0; i < 3; ++i)
+                    chunk.positions.push_back(parseFloat(p, lineEnd));
+            } else if (p[0] == 'v' && p[1] == 'n' && p + 2 < lineEnd && isSpace(p[2])) {
+                p += 3;
+                for (int i = 0; i < 3; ++i)
+                    chunk.normals.push_back(parseFloat(p, lineEnd));
+            } else if (p[0] == 'v' && p[1] == 't' && p + 2 < lineEnd && isSpace(p[2])) {
+                p += 3;
+                chunk.texcoords.push_back(parseFloat(p, lineEnd));
+                skipSpaces(p, lineEnd);
+                const bool hasV = p < lineEnd && *p != '\r';
+                chunk.texcoords.push_back(hasV ? parseFloat(p, lineEnd) : 0.0f);
+            } else if (p[0] == 'f' && isSpace(p[1])) {
+                p += 2;
+                polygon.clear();
+                const size_t positionCount = chunk.positions.size() / 3;
+                const size_t texcoordCount = chunk.texcoords.size() / 2;
+                const size_t normalCount = chunk.normals.size() / 3;
+                while (true) {
+                    skipSpaces(p, lineEnd);
+                    int32_t index;
+                    if (!parseInt(p, lineEnd, index))
+                        break;
+                    ObjCorner corner{0, 0, 0, 0};
+                    if (!encodeIndex(index, positionCount, corner.position, corner.flags, OBJ_POSITION_RELATIVE))
+                        throw std::runtime_error("Invalid OBJ face index 0");
+                    if (p < lineEnd && *p == '/') {
+                        ++p;
+                        if (parseInt(p, lineEnd, index) && encodeIndex(index, texcoordCount, corner.texcoord, corner.flags, OBJ_TEXCOORD_RELATIVE))
+                            corner.flags |= OBJ_HAS_TEXCOORD;
+                        if (p < lineEnd && *p == '/') {
+                            ++p;
+                            if (parseInt(p, lineEnd, index) && encodeIndex(index, normalCount, corner.normal, corner.flags, OBJ_NORMAL_RELATIVE))
+                                corner.flags |= OBJ_HAS_NORMAL;
+                        }
+                    }
+                    polygon.push_back(corner);
+                }
+                // Fan triangulation
+                for (size_t i = 2; i < polygon.size(); ++i) {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            } else if (lineEnd - p > 7 && std::memcmp(p, "usemtl", 6) == 0 && isSpace(p[6])) {
+                chunk.materialSwitches.emplace_back(static_cast<uint32_t>(chunk.corners.size() / 3), std::string(restOfLine(p + 7, lineEnd)));
+            } else if (lineEnd - p > 7 && std::memcmp(p, "mtllib", 6) == 0 && isSpace(p[6])) {
+                chunk.materialLibraries.emplace_back(restOfLine(p + 7, lineEnd));
+            }
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+// ---- Binary PLY parsing ----
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool isList = false;
+    PlyType countType = PlyType::UInt8;
+    size_t offset = 0; // Byte offset inside the record, only meaningful for fixed size elements
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+    size_t stride = 0; // Record size in bytes, 0 if the element contains lists
+
+    const PlyProperty* find(std::initializer_list<const char*> names) const {
+        for (const char* name : names)
+            for (const auto& property : properties)
+                if (property.name == name)
+                    return &property;
+        return nullptr;
+    }
+};
+
+size_t plyTypeSize(const PlyType type) {
+    switch (type) {
+        case PlyType::Int8: case PlyType::UInt8: return 1;
+        case PlyType::Int16: case PlyType::UInt16: return 2;
+        case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+PlyType parsePlyType(const std::string& name) {
+    if (name == "char" || name == "int8") return PlyType::Int8;
+    if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+    if (name == "short" || name == "int16") return PlyType::Int16;
+    if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+    if (name == "int" || name == "int32") return PlyType::Int32;
+    if (name == "uint" || name == "uint32") return PlyType::UInt32;
+    if (name == "float" || name == "float32") return PlyType::Float32;
+    if (name == "double" || name == "float64") return PlyType::Float64;
+    throw std::runtime_error("Unknown PLY property type: " + name);
+}
+
+template<typename T>
+T readPlyScalar(const char* p, const bool swapBytes) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swapBytes)
+        std::reverse(bytes, bytes + sizeof(T));
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double readPlyValue(const char* p, const PlyType type, const bool swapBytes) {
+    switch (type) {
+        case PlyType::Int8: return static_cast<int8_t>(*p);
+        case PlyType::UInt8: return static_cast<uint8_t>(*p);
+        case PlyType::Int16: return readPlyScalar<int16_t>(p, swapBytes);
+        case PlyType::UInt16: return readPlyScalar<uint16_t>(p, swapBytes);
+        case PlyType::Int32: return readPlyScalar<int32_t>(p, swapBytes);
+        case PlyType::UInt32: return readPlyScalar<uint32_t>(p, swapBytes);
+        case PlyType::Float32: return readPlyScalar<float>(p, swapBytes);
+        case PlyType::Float64: return readPlyScalar<double>(p, swapBytes);
+    }
+    return 0.0;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+// Reverses the bytes of each 32 bit lane with SSE2 alone, x86-64 builds do not enable SSSE3 shuffles by default
+__m128i byteSwap32(__m128i value) {
+    value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+#endif
+
+// Reads three consecutive float32 values, flipping y and z like the OBJ loader.
+// The 16 byte load may only be used when at least 16 bytes are readable at src.
+void loadPlyPosition(const char* src, const bool swapBytes, const bool canLoad16, vec3& dst) {
+#if defined(__SSE2__) || defined(_M_X64)
+    if (canLoad16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        if (swapBytes)
+            bytes = byteSwap32(bytes);
+        const __m128 signMask = _mm_castsi128_ps(_mm_set_epi32(0, static_cast<int>(0x80000000), static_cast<int>(0x80000000), 0));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, _mm_xor_ps(_mm_castsi128_ps(bytes), signMask));
+        dst = vec3(lanes[0], lanes[1], lanes[2]);
+        return;
+    }
+#elif defined(__ARM_NEON)
+    if (canLoad16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src));
+        if (swapBytes)
+            bytes = vrev32q_u8(bytes);
+        const uint32_t signBits[4] = {0, 0x80000000u, 0x80000000u, 0};
+        float lanes[4];
+        vst1q_f32(lanes, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_u8(bytes), vld1q_u32(signBits))));
+        dst = vec3(lanes[0], lanes[1], lanes[2]);
+        return;
+    }
+#endif
+    dst = vec3(readPlyScalar<float>(src, swapBytes), -readPlyScalar<float>(src + 4, swapBytes), -readPlyScalar<float>(src + 8, swapBytes));
+}
+
+// Reads three consecutive 32 bit indices, byte swapping four lanes at once where possible.
+void loadPlyTriangle(const char* src, const bool swapBytes, const bool canLoad16, uint32_t* dst) {
+#if defined(__SSE2__) || defined(_M_X64)
+    if (canLoad16 && swapBytes) {
+        alignas(16) uint32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), byteSwap32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+        std::memcpy(dst, lanes, sizeof(uint32_t) * 3);
+        return;
+    }
+#elif defined(__ARM_NEON)
+    if (canLoad16 && swapBytes) {
+        uint32_t lanes[4];
+        vst1q_u32(lanes, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(src)))));
+        std::memcpy(dst, lanes, sizeof(uint32_t) * 3);
+        return;
+    }
+#endif
+    for (int i = 0; i < 3; ++i)
+        dst[i] = readPlyScalar<uint32_t>(src + 4 * i, swapBytes);
+}
+
+vec3 anyPerpendicular(const vec3& n) {
+    const vec3 axis = std::fabs(n.x) < 0.9f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
+    return normalize(cross(axis, n));
+}
+
+} // namespace
+
 void Utils::loadCrtScene(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials)
 {
     std::ifstream f(filepath);
@@ -208,55 +625,20 @@ void Utils::loadObj(
     std::vector<Vertex>& vertices,
     std::vector<uint32_t>& indices,
     std::vector<Face>& faces,
-    std::vector<Material>& materials)
+    std::vector<Material>& materials,
+    std::vector<Texture>* pendingTextures)
 {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> mats;
     std::string warn, err;
 
-    std::string objDir;
-    size_t lastSlash = filepath.find_last_of("/\\");
-    objDir = (lastSlash != std::string::npos) ? filepath.substr(0, lastSlash) : ".";
+    const std::string objDir = directoryOf(filepath);
 
     if (!tinyobj::LoadObj(&attrib, &shapes, &mats, &warn, &err, filepath.c_str(), objDir.c_str()))
         throw std::runtime_error("Failed to load OBJ: " + warn + err);
 
-    // Load materials
-    materials.clear();
-    for (const auto& mat : mats) {
-        Material material{};
-        material.albedo = vec3(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2]);
-        material.specular = mat.specular[0];
-        material.metallic = mat.metallic;
-        material.roughness = mat.roughness;
-        material.ior = mat.ior;
-        material.transmissionColor = vec3(mat.transmittance[0], mat.transmittance[1], mat.transmittance[2]);
-        material.transmission = (mat.illum == 4 || mat.illum == 7) ? 1.0f : 0.0f;
-        material.opacity = mat.dissolve;
-        material.emission = vec3(mat.emission[0], mat.emission[1], mat.emission[2]);
-        material.emissionStrength = (material.emission != vec3(0.0f)) ? 1.0f : 0.0f;
-
-        auto addTexture = [&](const std::string& texname, int& index) {
-            if (!texname.empty()) {
-                std::string texturePath = objDir + "/" + texname;
-                if (std::filesystem::exists(texturePath)) {
-                    scene.add(Texture(scene.getContext(), texturePath));
-                    index = static_cast<int>(scene.getTextures().size() - 1);
-                } else
-                    std::cerr << "Warning: Texture file not found: " << texturePath << std::endl;
-            }
-        };
-
-        addTexture(mat.diffuse_texname, material.albedoIndex);
-        addTexture(mat.specular_texname, material.specularIndex);
-        addTexture(mat.roughness_texname, material.roughnessIndex);
-        addTexture(mat.normal_texname, material.normalIndex);
-        addTexture(mat.alpha_texname, material.opacityIndex);
-        addTexture(mat.emissive_texname, material.emissionIndex);
-
-        materials.push_back(material);
-    }
+    convertObjMaterials(scene, mats, objDir, materials, pendingTextures);
 
     // Load geometry
     for (const auto& shape : shapes) {
@@ -344,6 +726,441 @@ void Utils::loadObj(
     }
 }
 
+void Utils::loadObjParallel(
+    Scene& scene,
+    const std::string& filepath,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices,
+    std::vector<Face>& faces,
+    std::vector<Material>& materials,
+    std::vector<Texture>* pendingTextures)
+{
+    const MappedFile file(filepath);
+    const char* data = file.data();
+    const size_t size = file.size();
+    ThreadPool& pool = ThreadPool::get();
+
+    // Split into chunks that start at line boundaries
+    constexpr size_t minChunkSize = 1 << 20;
+    const size_t chunkCount = std::clamp<size_t>(size / minChunkSize, 1, static_cast<size_t>(pool.getThreadCount()) * 4);
+    std::vector<size_t> chunkStarts(chunkCount + 1, size);
+    chunkStarts[0] = 0;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        size_t start = std::max(size * i / chunkCount, chunkStarts[i - 1]);
+        const void* newline = start < size ? std::memchr(data + start, '\n', size - start) : nullptr;
+        chunkStarts[i] = newline ? static_cast<const char*>(newline) - data + 1 : size;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            parseObjChunk(data + chunkStarts[i], data + chunkStarts[i + 1], chunks[i]);
+    });
+
+    // Merge attribute streams and compute per chunk offsets
+    std::vector<size_t> positionBase(chunkCount), texcoordBase(chunkCount), normalBase(chunkCount), triangleBase(chunkCount);
+    size_t positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCount = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        positionBase[i] = positionCount;
+        texcoordBase[i] = texcoordCount;
+        normalBase[i] = normalCount;
+        triangleBase[i] = triangleCount;
+        positionCount += chunks[i].positions.size() / 3;
+        texcoordCount += chunks[i].texcoords.size() / 2;
+        normalCount += chunks[i].normals.size() / 3;
+        triangleCount += chunks[i].corners.size() / 3;
+    }
+
+    std::vector<float> positions(positionCount * 3), texcoords(texcoordCount * 2), normals(normalCount * 3);
+    pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::ranges::copy(chunks[i].positions, positions.begin() + positionBase[i] * 3);
+            std::ranges::copy(chunks[i].texcoords, texcoords.begin() + texcoordBase[i] * 2);
+            std::ranges::copy(chunks[i].normals, normals.begin() + normalBase[i] * 3);
+        }
+    });
+
+    // Materials
+    const std::string objDir = directoryOf(filepath);
+    std::vector<tinyobj::material_t> mats;
+    std::map<std::string, int> materialMap;
+    for (const auto& chunk : chunks) {
+        for (const auto& library : chunk.materialLibraries) {
+            std::ifstream mtlFile(objDir + "/" + library);
+            if (!mtlFile.is_open()) {
+                std::cerr << "Warning: Material library not found: " << objDir + "/" + library << std::endl;
+                continue;
+            }
+            std::string warn, err;
+            tinyobj::LoadMtl(&materialMap, &mats, &mtlFile, &warn, &err);
+            if (!err.empty())
+                std::cerr << "Warning: " << err << std::endl;
+        }
+    }
+    convertObjMaterials(scene, mats, objDir, materials, pendingTextures);
+
+    auto materialIndexOf = [&](const std::string& name) {
+        const auto it = materialMap.find(name);
+        return it != materialMap.end() ? it->second : 0;
+    };
+
+    // A chunk starts with whatever material was active at the end of the previous one
+    std::vector<int> chunkStartMaterial(chunkCount, 0);
+    std::vector<std::vector<std::pair<uint32_t, int>>> chunkSwitches(chunkCount);
+    int activeMaterial = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        chunkStartMaterial[i] = activeMaterial;
+        for (const auto& [firstTriangle, name] : chunks[i].materialSwitches) {
+            activeMaterial = materialIndexOf(name);
+            chunkSwitches[i].emplace_back(firstTriangle, activeMaterial);
+        }
+    }
+
+    // Emit one vertex per triangle corner, same layout as loadObj
+    const size_t vertexBase = vertices.size();
+    const size_t indexBase = indices.size();
+    const size_t faceBase = faces.size();
+    vertices.resize(vertexBase + triangleCount * 3);
+    indices.resize(indexBase + triangleCount * 3);
+    faces.resize(faceBase + triangleCount);
+
+    pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            const ObjChunk& chunk = chunks[c];
+            const size_t chunkTriangles = chunk.corners.size() / 3;
+            size_t nextSwitch = 0;
+            int materialIndex = chunkStartMaterial[c];
+
+            auto resolve = [](int32_t encoded, bool relative, size_t base, size_t count) {
+                const int64_t index = relative ? static_cast<int64_t>(base) + encoded : encoded;
+                if (index < 0 || index >= static_cast<int64_t>(count))
+                    throw std::runtime_error("OBJ face index out of range");
+                return static_cast<size_t>(index);
+            };
+
+            for (size_t t = 0; t < chunkTriangles; ++t) {
+                while (nextSwitch < chunkSwitches[c].size() && chunkSwitches[c][nextSwitch].first <= t)
+                    materialIndex = chunkSwitches[c][nextSwitch++].second;
+
+                const size_t triangle = triangleBase[c] + t;
+                faces[faceBase + triangle].materialIndex = materialIndex;
+
+                for (int v = 0; v < 3; ++v) {
+                    const ObjCorner& corner = chunk.corners[t * 3 + v];
+                    const size_t vertexIndex = vertexBase + triangle * 3 + v;
+                    Vertex& vertex = vertices[vertexIndex];
+
+                    const size_t p = resolve(corner.position, corner.flags & OBJ_POSITION_RELATIVE, positionBase[c], positionCount);
+                    vertex.position = vec3(positions[3 * p + 0], -positions[3 * p + 1], -positions[3 * p + 2]);
+
+                    if (corner.flags & OBJ_HAS_NORMAL) {
+                        const size_t n = resolve(corner.normal, corner.flags & OBJ_NORMAL_RELATIVE, normalBase[c], normalCount);
+                        vertex.normal = vec3(normals[3 * n + 0], -normals[3 * n + 1], -normals[3 * n + 2]);
+                    } else {
+                        vertex.normal = vec3(0.0f, 1.0f, 0.0f);
+                    }
+
+                    if (corner.flags & OBJ_HAS_TEXCOORD) {
+                        const size_t uv = resolve(corner.texcoord, corner.flags & OBJ_TEXCOORD_RELATIVE, texcoordBase[c], texcoordCount);
+                        vertex.uv = vec2(texcoords[2 * uv + 0], 1.0f - texcoords[2 * uv + 1]);
+                    } else {
+                        vertex.uv = vec2(0.0f);
+                    }
+
+                    indices[indexBase + triangle * 3 + v] = static_cast<uint32_t>(vertexIndex);
+                }
+
+                Vertex* triangleVertices = &vertices[vertexBase + triangle * 3];
+                const vec3 tangent = computeTangent(triangleVertices[0], triangleVertices[1], triangleVertices[2]);
+                for (int v = 0; v < 3; ++v)
+                    triangleVertices[v].tangent = tangent;
+            }
+        }
+    });
+}
+
+void Utils::loadPly(
+    Scene& scene,
+    const std::string& filepath,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices,
+    std::vector<Face>& faces,
+    std::vector<Material>& materials)
+{
+    const MappedFile file(filepath);
+    const char* data = file.data();
+    const char* fileEnd = data + file.size();
+    ThreadPool& pool = ThreadPool::get();
+
+    // Header
+    static constexpr std::string_view headerEnd = "end_header";
+    const std::string_view contents = file.view();
+    if (!contents.starts_with("ply"))
+        throw std::runtime_error("Not a PLY file: " + filepath);
+    const size_t headerEndPos = contents.find(headerEnd);
+    if (headerEndPos == std::string_view::npos)
+        throw std::runtime_error("PLY header is not terminated: " + filepath);
+    const char* body = static_cast<const char*>(std::memchr(data + headerEndPos, '\n', file.size() - headerEndPos));
+    if (!body)
+        throw std::runtime_error("PLY file has no data: " + filepath);
+    ++body;
+
+    bool swapBytes = false;
+    std::vector<PlyElement> elements;
+    std::istringstream header(std::string(contents.substr(0, headerEndPos)));
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii")
+                throw std::runtime_error("ASCII PLY files are not supported: " + filepath);
+            swapBytes = (format == "binary_big_endian") != (std::endian::native == std::endian::big);
+        } else if (keyword == "element") {
+            PlyElement element;
+            tokens >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property") {
+            if (elements.empty())
+                throw std::runtime_error("PLY property outside of element: " + filepath);
+            PlyProperty property;
+            std::string type;
+            tokens >> type;
+            if (type == "list") {
+                std::string countType, valueType;
+                tokens >> countType >> valueType;
+                property.isList = true;
+                property.countType = parsePlyType(countType);
+                property.type = parsePlyType(valueType);
+            } else {
+                property.type = parsePlyType(type);
+            }
+            tokens >> property.name;
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    for (auto& element : elements) {
+        size_t offset = 0;
+        bool fixedSize = true;
+        for (auto& property : element.properties) {
+            property.offset = offset;
+            if (property.isList) {
+                fixedSize = false;
+                break;
+            }
+            offset += plyTypeSize(property.type);
+        }
+        element.stride = fixedSize ? offset : 0;
+    }
+
+    // Walks past an element whose records contain lists
+    auto skipVariableElement = [&](const PlyElement& element, const char* p) {
+        for (size_t i = 0; i < element.count; ++i) {
+            for (const auto& property : element.properties) {
+                if (property.isList) {
+                    if (p + plyTypeSize(property.countType) > fileEnd)
+                        throw std::runtime_error("PLY file is truncated: " + filepath);
+                    const auto count = static_cast<size_t>(readPlyValue(p, property.countType, swapBytes));
+                    p += plyTypeSize(property.countType) + count * plyTypeSize(property.type);
+                } else {
+                    p += plyTypeSize(property.type);
+                }
+            }
+        }
+        return p;
+    };
+
+    const PlyElement* vertexElement = nullptr;
+    const PlyElement* faceElement = nullptr;
+    const char* vertexData = nullptr;
+    const char* faceData = nullptr;
+    const char* faceDataEnd = nullptr;
+    const char* p = body;
+    for (const auto& element : elements) {
+        const char* start = p;
+        p = element.stride ? p + element.stride * element.count : skipVariableElement(element, p);
+        if (p > fileEnd)
+            throw std::runtime_error("PLY file is truncated: " + filepath);
+        if (element.name == "vertex") {
+            vertexElement = &element;
+            vertexData = start;
+        } else if (element.name == "face") {
+            faceElement = &element;
+            faceData = start;
+            faceDataEnd = p;
+        }
+    }
+    if (!vertexElement || !vertexElement->stride)
+        throw std::runtime_error("PLY file has no usable vertex element: " + filepath);
+
+    // Vertices
+    const PlyProperty* px = vertexElement->find({"x"});
+    const PlyProperty* py = vertexElement->find({"y"});
+    const PlyProperty* pz = vertexElement->find({"z"});
+    if (!px || !py || !pz)
+        throw std::runtime_error("PLY vertices have no position: " + filepath);
+    const PlyProperty* nx = vertexElement->find({"nx"});
+    const PlyProperty* ny = vertexElement->find({"ny"});
+    const PlyProperty* nz = vertexElement->find({"nz"});
+    const PlyProperty* pu = vertexElement->find({"u", "s", "texture_u", "texture_s"});
+    const PlyProperty* pv = vertexElement->find({"v", "t", "texture_v", "texture_t"});
+    const bool hasNormals = nx && ny && nz;
+    const bool hasUVs = pu && pv;
+    const bool packedPositions = px->type == PlyType::Float32 && py->type == PlyType::Float32 && pz->type == PlyType::Float32
+        && py->offset == px->offset + 4 && pz->offset == px->offset + 8;
+
+    const size_t vertexStride = vertexElement->stride;
+    const size_t vertexCount = vertexElement->count;
+    const size_t vertexBase = vertices.size();
+    vertices.resize(vertexBase + vertexCount);
+
+    pool.parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const char* record = vertexData + i * vertexStride;
+            Vertex& vertex = vertices[vertexBase + i];
+            if (packedPositions) {
+                const char* src = record + px->offset;
+                loadPlyPosition(src, swapBytes, src + 16 <= fileEnd, vertex.position);
+            } else {
+                vertex.position = vec3(
+                    readPlyValue(record + px->offset, px->type, swapBytes),
+                    -readPlyValue(record + py->offset, py->type, swapBytes),
+                    -readPlyValue(record + pz->offset, pz->type, swapBytes));
+            }
+            if (hasNormals) {
+                vertex.normal = vec3(
+                    readPlyValue(record + nx->offset, nx->type, swapBytes),
+                    -readPlyValue(record + ny->offset, ny->type, swapBytes),
+                    -readPlyValue(record + nz->offset, nz->type, swapBytes));
+            }
+            if (hasUVs) {
+                vertex.uv = vec2(
+                    readPlyValue(record + pu->offset, pu->type, swapBytes),
+                    1.0f - readPlyValue(record + pv->offset, pv->type, swapBytes));
+            }
+        }
+    });
+
+    // Faces
+    const size_t indexBase = indices.size();
+    const size_t faceBase = faces.size();
+    const PlyProperty* indexList = faceElement ? faceElement->find({"vertex_indices", "vertex_index"}) : nullptr;
+    if (indexList && indexList->isList) {
+        const size_t countSize = plyTypeSize(indexList->countType);
+        const size_t indexSize = plyTypeSize(indexList->type);
+        const size_t faceCount = faceElement->count;
+        const bool onlyIndices = faceElement->properties.size() == 1;
+        const size_t triangleStride = countSize + 3 * indexSize;
+
+        // Most scans are pure triangle meshes: every record then has the same size and can be converted in parallel
+        bool allTriangles = onlyIndices && static_cast<size_t>(faceDataEnd - faceData) == faceCount * triangleStride;
+        if (allTriangles) {
+            std::atomic<bool> valid = true;
+            pool.parallelFor(faceCount, 1 << 16, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end && valid.load(std::memory_order_relaxed); ++i)
+                    if (readPlyValue(faceData + i * triangleStride, indexList->countType, swapBytes) != 3.0)
+                        valid = false;
+            });
+            allTriangles = valid;
+        }
+
+        if (allTriangles) {
+            const bool fastIndices = indexList->type == PlyType::Int32 || indexList->type == PlyType::UInt32;
+            indices.resize(indexBase + faceCount * 3);
+            pool.parallelFor(faceCount, 1 << 16, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const char* src = faceData + i * triangleStride + countSize;
+                    uint32_t* dst = &indices[indexBase + i * 3];
+                    if (fastIndices) {
+                        loadPlyTriangle(src, swapBytes, src + 16 <= fileEnd, dst);
+                    } else {
+                        for (int v = 0; v < 3; ++v)
+                            dst[v] = static_cast<uint32_t>(readPlyValue(src + v * indexSize, indexList->type, swapBytes));
+                    }
+                }
+            });
+        } else {
+            // Mixed polygons, fan triangulate sequentially
+            const char* record = faceData;
+            std::vector<uint32_t> polygon;
+            for (size_t i = 0; i < faceCount; ++i) {
+                for (const auto& property : faceElement->properties) {
+                    const size_t count = property.isList ? static_cast<size_t>(readPlyValue(record, property.countType, swapBytes)) : 1;
+                    const char* values = property.isList ? record + plyTypeSize(property.countType) : record;
+                    if (&property == indexList) {
+                        polygon.resize(count);
+                        for (size_t v = 0; v < count; ++v)
+                            polygon[v] = static_cast<uint32_t>(readPlyValue(values + v * indexSize, property.type, swapBytes));
+                        for (size_t v = 2; v < count; ++v) {
+                            indices.push_back(polygon[0]);
+                            indices.push_back(polygon[v - 1]);
+                            indices.push_back(polygon[v]);
+                        }
+                    }
+                    record = values + count * plyTypeSize(property.type);
+                }
+            }
+        }
+    }
+
+    const size_t triangleCount = (indices.size() - indexBase) / 3;
+    std::atomic<bool> indicesValid = true;
+    pool.parallelFor(triangleCount * 3, 1 << 18, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t& index = indices[indexBase + i];
+            if (index >= vertexCount)
+                indicesValid = false;
+            index += static_cast<uint32_t>(vertexBase);
+        }
+    });
+    if (!indicesValid)
+        throw std::runtime_error("PLY face index out of range: " + filepath);
+
+    faces.resize(faceBase + triangleCount);
+    materials.clear();
+    materials.emplace_back();
+
+    // Scans usually come without normals or UVs, derive them from the triangles
+    if (!hasNormals || hasUVs) {
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const uint32_t* tri = &indices[indexBase + t * 3];
+            Vertex& v0 = vertices[tri[0]];
+            Vertex& v1 = vertices[tri[1]];
+            Vertex& v2 = vertices[tri[2]];
+            if (!hasNormals) {
+                // Area weighted
+                const vec3 normal = cross(v1.position - v0.position, v2.position - v0.position);
+                v0.normal += normal;
+                v1.normal += normal;
+                v2.normal += normal;
+            }
+            if (hasUVs) {
+                const vec3 tangent = computeTangent(v0, v1, v2);
+                v0.tangent += tangent;
+                v1.tangent += tangent;
+                v2.tangent += tangent;
+            }
+        }
+    }
+
+    pool.parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Vertex& vertex = vertices[vertexBase + i];
+            vertex.normal = length2(vertex.normal) > 1e-16f ? normalize(vertex.normal) : vec3(0.0f, 1.0f, 0.0f);
+            if (length2(vertex.tangent) > 1e-8f) {
+                // Gram-Schmidt against the final normal
+                const vec3 tangent = vertex.tangent - vertex.normal * dot(vertex.normal, vertex.tangent);
+                vertex.tangent = length2(tangent) > 1e-8f ? normalize(tangent) : anyPerpendicular(vertex.normal);
+            } else {
+                vertex.tangent = anyPerpendicular(vertex.normal);
+            }
+        }
+    });
+}
 
 std::string Utils::nameFromPath(const std::string& path) {
     size_t lastSlash = path.find_last_of("/\\");
@@ -10,7 +10,13 @@
 class Utils {
 public:
     static void loadCrtScene(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials);
-    static void loadObj(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials);
+    // Textures referenced by materials are added to the scene, or to pendingTextures (with indices into that list) when given
+    static void loadObj(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials, std::vector<Texture>* pendingTextures = nullptr);
+    // Same output as loadObj, but memory maps the file and parses it in parallel chunks
+    static void loadObjParallel(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials, std::vector<Texture>* pendingTextures = nullptr);
+
+    // Binary (little or big endian) PLY with shared vertices; normals and tangents are derived when missing
+    static void loadPly(Scene& scene, const std::string& filepath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Face>& faces, std::vector<Material>& materials);
 
     static std::string nameFromPath(const std::string& path);
     static std::vector<char> readFile(const std::string& filename);
@@ -1,9 +1,16 @@
 ﻿#include "Accel.h"
+#include <algorithm>
+#include <stdexcept>
+
+void Accel::build(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount, vk::AccelerationStructureTypeKHR type, bool allowUpdate) {
+    this->type = type;
+    buildFlags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace;
+    if (allowUpdate)
+        buildFlags |= vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
 
-void Accel::build(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount, vk::AccelerationStructureTypeKHR type) {
     vk::AccelerationStructureBuildGeometryInfoKHR buildGeometryInfo{};
     buildGeometryInfo.setType(type);
-    buildGeometryInfo.setFlags(vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace);
+    buildGeometryInfo.setFlags(buildFlags);
     buildGeometryInfo.setGeometries(geometry);
 
     // Get sizes required for AS buffers
@@ -13,6 +20,7 @@ void Accel::build(Context& context, vk::AccelerationStructureGeometryKHR geometr
 
     // Allocate buffer for acceleration structure storage
     vk::DeviceSize size = buildSizesInfo.accelerationStructureSize;
+    updateScratchSize = buildSizesInfo.updateScratchSize;
     buffer = Buffer(context, Buffer::Type::AccelStorage, size);
 
     // Create acceleration structure
@@ -37,8 +45,31 @@ void Accel::build(Context& context, vk::AccelerationStructureGeometryKHR geometr
     // Submit build command once
     context.oneTimeSubmit([&](vk::CommandBuffer commandBuffer) {
         commandBuffer.buildAccelerationStructuresKHR(buildGeometryInfo, &buildRangeInfo);
-    });
+    }, type == vk::AccelerationStructureTypeKHR::eBottomLevel ? "BLAS Build" : "TLAS Build");
 
     // Update descriptor info for binding
     descAccelInfo.setAccelerationStructures(*accel);
-}
\ No newline at end of file
+}
+
+void Accel::update(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount) {
+    if (!isUpdatable())
+        throw std::runtime_error("Acceleration structure was not built with update support.");
+
+    vk::AccelerationStructureBuildGeometryInfoKHR buildGeometryInfo{};
+    buildGeometryInfo.setType(type);
+    buildGeometryInfo.setFlags(buildFlags); // Must match the original build
+    buildGeometryInfo.setMode(vk::BuildAccelerationStructureModeKHR::eUpdate);
+    buildGeometryInfo.setGeometries(geometry);
+    buildGeometryInfo.setSrcAccelerationStructure(*accel);
+    buildGeometryInfo.setDstAccelerationStructure(*accel);
+
+    Buffer scratchBuffer{context, Buffer::Type::Scratch, std::max<vk::DeviceSize>(updateScratchSize, 1)};
+    buildGeometryInfo.setScratchData(scratchBuffer.getDeviceAddress());
+
+    vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
+    buildRangeInfo.setPrimitiveCount(primitiveCount);
+
+    context.oneTimeSubmit([&](vk::CommandBuffer commandBuffer) {
+        commandBuffer.buildAccelerationStructuresKHR(buildGeometryInfo, &buildRangeInfo);
+    }, type == vk::AccelerationStructureTypeKHR::eBottomLevel ? "BLAS Refit" : "TLAS Update");
+}
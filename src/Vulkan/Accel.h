@@ -9,13 +9,17 @@ class Accel {
     vk::UniqueAccelerationStructureKHR accel;
     vk::WriteDescriptorSetAccelerationStructureKHR descAccelInfo{};
     vk::AccelerationStructureTypeKHR type{};
+    vk::BuildAccelerationStructureFlagsKHR buildFlags{};
+    vk::DeviceSize updateScratchSize = 0;
 
 public:
     Accel() = default;
     Accel(Accel&& other) noexcept = default;
     Accel& operator=(Accel&& other) noexcept = default;
 
-    void build(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount, vk::AccelerationStructureTypeKHR type);
+    void build(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount, vk::AccelerationStructureTypeKHR type, bool allowUpdate = false);
+    // Refits in place for moved vertices, topology and primitive count must match the last build
+    void update(Context& context, vk::AccelerationStructureGeometryKHR geometry, uint32_t primitiveCount);
     ~Accel() = default;
     
     // Getters
@@ -23,4 +27,5 @@ public:
     const vk::AccelerationStructureKHR& getAccelerationStructure() const { return accel.get(); }
     const vk::WriteDescriptorSetAccelerationStructureKHR& getDescriptorAccelerationStructureInfo() const { return descAccelInfo; }
     vk::AccelerationStructureTypeKHR getType() const { return type; }
+    bool isUpdatable() const { return accel && (buildFlags & vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate); }
 };
\ No newline at end of file
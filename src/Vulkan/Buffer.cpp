@@ -1,4 +1,6 @@
 ﻿#include "Buffer.h"
+#include <cstring>
+#include <stdexcept>
 
 Buffer::Buffer() {
     descBufferInfo.setBuffer(VK_NULL_HANDLE);
@@ -89,4 +91,16 @@ Buffer::Buffer(const Context& context, const Type type, vk::DeviceSize size, con
 
         context.getDevice().unmapMemory(*memory);
     }
-}
\ No newline at end of file
+}
+
+void Buffer::update(const Context& context, const void* data, const vk::DeviceSize size, const vk::DeviceSize offset) const {
+    if (!buffer || size == 0)
+        return;
+    if (offset + size > descBufferInfo.range)
+        throw std::runtime_error("Buffer update out of range.");
+
+    // Host visible buffers in this app are all coherent, no flush needed
+    void* mapped = context.getDevice().mapMemory(*memory, offset, size);
+    std::memcpy(mapped, data, size);
+    context.getDevice().unmapMemory(*memory);
+}
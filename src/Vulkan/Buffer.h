@@ -16,6 +16,9 @@ public:
     Buffer();
     Buffer(const Context& context, Type type, vk::DeviceSize size, const void* data = nullptr, vk::BufferUsageFlags usage = {}, vk::MemoryPropertyFlags memoryProps = {});
 
+    // Overwrites part of a host visible buffer
+    void update(const Context& context, const void* data, vk::DeviceSize size, vk::DeviceSize offset = 0) const;
+
     vk::DeviceAddress getDeviceAddress() const { return deviceAddress; }
     const vk::DescriptorBufferInfo& getDescriptorInfo() const { return descBufferInfo; }
     const vk::Buffer& getBuffer() const { return buffer.get(); }
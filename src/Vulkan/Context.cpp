@@ -1,4 +1,5 @@
 ﻿#include "Context.h"
+#include "GpuProfiler.h"
 #include <iostream>
 #include <set>
 #include <algorithm>
@@ -311,20 +312,32 @@ uint32_t Context::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags pr
     throw std::runtime_error("Failed to find suitable memory type!");
 }
 
-void Context::oneTimeSubmit(const std::function<void(vk::CommandBuffer)>& func) {
-    
-    vk::CommandBufferAllocateInfo allocInfo(commandPool.get(), vk::CommandBufferLevel::ePrimary, 1);
+void Context::oneTimeSubmit(const std::function<void(vk::CommandBuffer)>& func, const char* profileScope) {
+    // Command pools are externally synchronized, so a worker thread cannot share the main pool
+    vk::CommandPoolCreateInfo poolInfo(vk::CommandPoolCreateFlagBits::eTransient, queueFamilyIndices.front());
+    vk::UniqueCommandPool transientPool = device->createCommandPoolUnique(poolInfo);
+
+    vk::CommandBufferAllocateInfo allocInfo(transientPool.get(), vk::CommandBufferLevel::ePrimary, 1);
     vk::UniqueCommandBuffer commandBuffer = std::move(device->allocateCommandBuffersUnique(allocInfo).front());
 
     commandBuffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    const int timerScope = profiler && profileScope ? profiler->beginSubmit(*commandBuffer) : -1;
     func(*commandBuffer);
+    if (timerScope >= 0)
+        profiler->endSubmit(*commandBuffer, timerScope);
     commandBuffer->end();
 
     vk::UniqueFence fence = device->createFenceUnique({});
     vk::SubmitInfo submitInfo({}, {}, *commandBuffer);
-    queue.submit(submitInfo, *fence);
+    {
+        std::lock_guard lock(queueMutex);
+        queue.submit(submitInfo, *fence);
+    }
 
     (void)device->waitForFences(*fence, VK_TRUE, UINT64_MAX);
+
+    if (timerScope >= 0)
+        profiler->finishSubmit(timerScope, profileScope);
 }
 
 vk::PresentModeKHR Context::chooseSwapPresentMode() const {
@@ -377,8 +390,10 @@ void Context::queryWindowSize()
 
 Context::~Context() {
     std::cout << "Destroying Context..." << std::endl;
-    if (device)
+    if (device) {
+        std::lock_guard lock(queueMutex);
         device->waitIdle();
+    }
 
     SDL_DestroyWindow(window);
     SDL_Vulkan_UnloadLibrary();
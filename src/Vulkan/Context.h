@@ -9,6 +9,8 @@
 
 #include "SDL3/SDL_video.h"
 
+class GpuProfiler;
+
 class Context {
 
     std::vector<const char*> RequiredDeviceExtensions = {
@@ -44,6 +46,8 @@ class Context {
     std::vector<uint32_t> queueFamilyIndices;
     vk::UniqueCommandPool commandPool;
     vk::UniqueDescriptorPool descriptorPool;
+    std::mutex queueMutex; // The queue is shared with background imports
+    GpuProfiler* profiler = nullptr;
 
     bool rtxSupported = false;
 
@@ -57,7 +61,12 @@ public:
 
     // Helper functions
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
-    void oneTimeSubmit(const std::function<void(vk::CommandBuffer)>& func);
+    // Safe to call from any thread, each call records into its own transient pool
+    // Submissions with a profile scope are timed and reported to the profiler, if one is set
+    void oneTimeSubmit(const std::function<void(vk::CommandBuffer)>& func, const char* profileScope = nullptr);
+    void setProfiler(GpuProfiler* gpuProfiler) { profiler = gpuProfiler; }
+    // Must be held around every vkQueueSubmit/vkQueuePresentKHR
+    std::unique_lock<std::mutex> lockQueue() { return std::unique_lock(queueMutex); }
     vk::PresentModeKHR chooseSwapPresentMode() const;
     vk::SurfaceFormatKHR chooseSwapSurfaceFormat() const;
 
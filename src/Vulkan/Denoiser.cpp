@@ -0,0 +1,81 @@
+﻿#include "Denoiser.h"
+#include <algorithm>
+#include <iostream>
+
+#include "Globals.h"
+#include "Utils.h"
+
+Denoiser::Denoiser(Context& context, uint32_t width, uint32_t height, const Image& colorImage, const Image& albedoImage, const Image& normalImage, const Image& momentsImage)
+: pingImage(context, width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage),
+  pongImage(context, width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage),
+  outputImage(context, width, height, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc)
+{
+    //Load shader
+    static constexpr unsigned char code[] = {
+        #embed "../Shaders/Denoising/Denoiser.spv"
+    };
+    shaderModule = context.getDevice().createShaderModuleUnique({{}, sizeof(code), reinterpret_cast<const uint32_t*>(code)});
+
+    // Color, albedo, normal and moments in, ping and pong between iterations, filtered color out
+    const std::vector<const Image*> images = {&colorImage, &albedoImage, &normalImage, &momentsImage, &pingImage, &pongImage, &outputImage};
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i < images.size(); ++i)
+        bindings.emplace_back(i, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute);
+
+    descriptorSetLayout = context.getDevice().createDescriptorSetLayoutUnique({{}, static_cast<uint32_t>(bindings.size()), bindings.data()});
+
+    vk::PushConstantRange pushRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(DenoiserPushData));
+    pipelineLayout = context.getDevice().createPipelineLayoutUnique({{}, 1, &*descriptorSetLayout, 1, &pushRange});
+
+    // Compute pipeline
+    vk::PipelineShaderStageCreateInfo shaderStage({}, vk::ShaderStageFlagBits::eCompute, *shaderModule, "main");
+
+    pipeline = context.getDevice().createComputePipelineUnique({}, {{}, shaderStage, *pipelineLayout}).value;
+
+    vk::DescriptorSetAllocateInfo allocInfo(context.getDescriptorPool(), 1, &descriptorSetLayout.get());
+    auto descriptorSets = context.getDevice().allocateDescriptorSetsUnique(allocInfo);
+    descriptorSet = std::move(descriptorSets.front());
+
+    // Write descriptors
+    std::vector<vk::DescriptorImageInfo> imageInfos;
+    for (const Image* image : images)
+        imageInfos.emplace_back(vk::Sampler{}, image->getImageView(), vk::ImageLayout::eGeneral);
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < imageInfos.size(); ++i)
+        writes.push_back(vk::WriteDescriptorSet()
+            .setDstSet(descriptorSet.get())
+            .setDstBinding(i)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setImageInfo(imageInfos[i])
+            .setDescriptorCount(1));
+
+    context.getDevice().updateDescriptorSets(writes, {});
+}
+
+Denoiser::~Denoiser()
+{
+    std::cout << "Destroying Denoiser" << std::endl;
+}
+
+void Denoiser::dispatch(const vk::CommandBuffer commandBuffer, DenoiserPushData settings) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, descriptorSet.get(), {});
+    uint32_t groupCountX = (outputImage.getImageCreateInfo().extent.width + GROUP_SIZE - 1) / GROUP_SIZE;
+    uint32_t groupCountY = (outputImage.getImageCreateInfo().extent.height + GROUP_SIZE - 1) / GROUP_SIZE;
+
+    // Every pass reads what the previous one (or the path tracer) wrote, the pass through still needs one dispatch
+    const int passCount = std::max(settings.iterationCount, 1);
+    for (int iteration = 0; iteration < passCount; ++iteration) {
+        vk::MemoryBarrier barrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite};
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eComputeShader, {}, barrier, {}, {});
+
+        settings.iteration = iteration;
+        commandBuffer.pushConstants(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(DenoiserPushData), &settings);
+        commandBuffer.dispatch(groupCountX, groupCountY, 1);
+    }
+
+    vk::MemoryBarrier barrier{vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead};
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, barrier, {}, {});
+}
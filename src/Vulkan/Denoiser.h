@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include "../Vulkan/Context.h"
+#include "../Vulkan/Image.h"
+#include "../Shaders/SharedStructs.h"
+
+// Edge-avoiding a-trous wavelet filter (SVGF style) between the path tracer and the tonemapper.
+// Guided by the albedo, normal and luminance variance AOVs, one dispatch per iteration.
+class Denoiser {
+public:
+    Denoiser(Context& context, uint32_t width, uint32_t height, const Image& colorImage, const Image& albedoImage, const Image& normalImage, const Image& momentsImage);
+    ~Denoiser();
+
+    // iteration is filled in per pass, iterationCount 0 copies the color unfiltered
+    void dispatch(vk::CommandBuffer commandBuffer, DenoiserPushData settings);
+    Image& getOutputImage() { return outputImage; }
+
+private:
+    Image pingImage;
+    Image pongImage;
+    Image outputImage;
+    vk::UniqueShaderModule shaderModule;
+    vk::UniqueDescriptorSetLayout descriptorSetLayout;
+    vk::UniquePipelineLayout pipelineLayout;
+    vk::UniquePipeline pipeline;
+    vk::UniqueDescriptorSet descriptorSet;
+};
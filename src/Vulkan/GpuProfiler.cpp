@@ -0,0 +1,131 @@
+﻿#include "GpuProfiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <nlohmann/json.hpp>
+
+GpuProfiler::GpuProfiler(Context& context, const uint32_t slotCount)
+{
+    for (uint32_t i = 0; i < slotCount; ++i)
+        timers.push_back(std::make_unique<GpuTimer>(context, PASS_COUNT));
+
+    submitTimer = std::make_unique<GpuTimer>(context, SUBMIT_SCOPES);
+    for (int scope = SUBMIT_SCOPES - 1; scope >= 0; --scope)
+        freeSubmitScopes.push_back(scope);
+}
+
+const char* GpuProfiler::getPassName(const Pass pass) {
+    switch (pass) {
+        case RENDER: return "Path Tracing";
+        case DENOISE: return "Denoiser";
+        case TONEMAP: return "Tonemapper";
+        case VIEWPORT_COPY: return "Viewport Copy";
+        case IMGUI: return "ImGui";
+        default: return "Unknown";
+    }
+}
+
+void GpuProfiler::beginCommandBuffer(const vk::CommandBuffer commandBuffer, const uint32_t slot) {
+    GpuTimer& timer = *timers[slot];
+    if (timer.collect()) {
+        for (uint32_t pass = 0; pass < PASS_COUNT; ++pass) {
+            const float milliseconds = timer.getMilliseconds(pass);
+            if (milliseconds >= 0.0f)
+                addSample(getPassName(static_cast<Pass>(pass)), slot, timer.getBeginMilliseconds(pass), milliseconds);
+        }
+    }
+    timer.reset(commandBuffer);
+}
+
+void GpuProfiler::begin(const vk::CommandBuffer commandBuffer, const uint32_t slot, const Pass pass) {
+    timers[slot]->begin(commandBuffer, pass);
+}
+
+void GpuProfiler::end(const vk::CommandBuffer commandBuffer, const uint32_t slot, const Pass pass) {
+    timers[slot]->end(commandBuffer, pass);
+}
+
+int GpuProfiler::beginSubmit(const vk::CommandBuffer commandBuffer) {
+    std::lock_guard lock(mutex);
+    if (freeSubmitScopes.empty())
+        return -1;
+    const int scope = freeSubmitScopes.back();
+    freeSubmitScopes.pop_back();
+    submitTimer->reset(commandBuffer, scope);
+    submitTimer->begin(commandBuffer, scope);
+    return scope;
+}
+
+void GpuProfiler::endSubmit(const vk::CommandBuffer commandBuffer, const int scope) {
+    std::lock_guard lock(mutex);
+    submitTimer->end(commandBuffer, scope);
+}
+
+void GpuProfiler::finishSubmit(const int scope, const std::string& name) {
+    float milliseconds;
+    double beginMilliseconds;
+    bool available;
+    {
+        std::lock_guard lock(mutex);
+        available = submitTimer->collect(scope);
+        milliseconds = submitTimer->getMilliseconds(scope);
+        beginMilliseconds = submitTimer->getBeginMilliseconds(scope);
+        freeSubmitScopes.push_back(scope);
+    }
+    if (available)
+        addSample(name, SUBMIT_TRACK, beginMilliseconds, milliseconds);
+}
+
+void GpuProfiler::addSample(const std::string& name, const uint32_t track, const double beginMilliseconds, const float milliseconds) {
+    std::lock_guard lock(mutex);
+    auto& samples = history[name];
+    samples.push_back(milliseconds);
+    if (samples.size() > HISTORY_SIZE)
+        samples.pop_front();
+
+    trace.push_back({name, track, beginMilliseconds, milliseconds});
+    if (trace.size() > TRACE_SIZE)
+        trace.pop_front();
+}
+
+std::vector<GpuProfiler::Stats> GpuProfiler::getStats() const {
+    std::lock_guard lock(mutex);
+    std::vector<Stats> stats;
+    for (const auto& [name, samples] : history) {
+        if (samples.empty())
+            continue;
+        std::vector<float> sorted(samples.begin(), samples.end());
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](const float p) { return sorted[static_cast<size_t>(p * static_cast<float>(sorted.size() - 1) + 0.5f)]; };
+        const float sum = std::accumulate(sorted.begin(), sorted.end(), 0.0f);
+        stats.push_back({name, sum / static_cast<float>(sorted.size()), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back(), sorted.size()});
+    }
+    return stats;
+}
+
+void GpuProfiler::exportTrace(const std::string& filename) const {
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard lock(mutex);
+        // Timestamps share the queue's timeline, start the trace at zero
+        const double origin = trace.empty() ? 0.0 : std::min_element(trace.begin(), trace.end(), [](const Event& a, const Event& b) { return a.begin < b.begin; })->begin;
+        for (const Event& event : trace)
+            events.push_back({{"name", event.name}, {"ph", "X"}, {"pid", 0}, {"tid", event.track},
+                              {"ts", (event.begin - origin) * 1000.0}, {"dur", event.duration * 1000.0}});
+    }
+
+    nlohmann::json statistics = nlohmann::json::array();
+    for (const Stats& s : getStats())
+        statistics.push_back({{"name", s.name}, {"averageMs", s.average}, {"medianMs", s.median}, {"p95Ms", s.p95},
+                              {"p99Ms", s.p99}, {"maxMs", s.max}, {"samples", s.samples}});
+
+    const nlohmann::json document = {{"traceEvents", events}, {"displayTimeUnit", "ms"}, {"statistics", statistics}};
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return;
+    }
+    file << document.dump(1);
+    std::cout << "Saved GPU trace to " << filename << std::endl;
+}
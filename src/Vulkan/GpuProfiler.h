@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "Context.h"
+#include "GpuTimer.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Rolling GPU timings per pass. Command buffers recorded every frame own a GpuTimer slot that is read back right
+// before the slot is recorded again, synchronous submissions (acceleration structure builds) report right away.
+class GpuProfiler {
+public:
+    enum Pass : uint32_t { RENDER, DENOISE, TONEMAP, VIEWPORT_COPY, IMGUI, PASS_COUNT };
+    static constexpr uint32_t COMPUTE_SLOT = 0; // Slots 1 to MAX_FRAMES_IN_FLIGHT are the graphics frames
+    static constexpr uint32_t SUBMIT_TRACK = 100; // Trace track of one time submissions
+    static constexpr size_t HISTORY_SIZE = 240;  // Samples per pass the statistics cover
+    static constexpr size_t TRACE_SIZE = 8192;   // Events kept for export
+    static constexpr uint32_t SUBMIT_SCOPES = 16; // One time submissions that can be timed at once
+
+    struct Stats {
+        std::string name;
+        float average, median, p95, p99, max;
+        size_t samples;
+    };
+
+    GpuProfiler(Context& context, uint32_t slotCount);
+
+    // Reads the slot's previous recording into the statistics, then starts a new one
+    void beginCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t slot);
+    void begin(vk::CommandBuffer commandBuffer, uint32_t slot, Pass pass);
+    void end(vk::CommandBuffer commandBuffer, uint32_t slot, Pass pass);
+
+    // Times a one time submission from any thread: beginSubmit after the command buffer began, endSubmit before
+    // it ends and finishSubmit once its fence signaled. Returns -1 while all submit scopes are in use, the
+    // submission is not timed then.
+    int beginSubmit(vk::CommandBuffer commandBuffer);
+    void endSubmit(vk::CommandBuffer commandBuffer, int scope);
+    void finishSubmit(int scope, const std::string& name);
+
+    // Thread safe, for work timed outside the slots
+    void addSample(const std::string& name, uint32_t track, double beginMilliseconds, float milliseconds);
+    // Time of a pass in the slot's last collected recording, negative if it was not available
+    float getLastMilliseconds(uint32_t slot, Pass pass) const { return timers[slot]->getMilliseconds(pass); }
+
+    std::vector<Stats> getStats() const;
+    // Chrome trace event format, open with chrome://tracing or Perfetto. Statistics are stored alongside.
+    void exportTrace(const std::string& filename) const;
+
+    static const char* getPassName(Pass pass);
+
+private:
+    struct Event {
+        std::string name;
+        uint32_t track;
+        double begin;
+        float duration;
+    };
+
+    std::vector<std::unique_ptr<GpuTimer>> timers;
+    std::unique_ptr<GpuTimer> submitTimer; // Shared by the submitting threads, guarded by mutex
+    std::vector<int> freeSubmitScopes;
+    mutable std::mutex mutex;
+    std::map<std::string, std::deque<float>> history;
+    std::deque<Event> trace;
+};
@@ -0,0 +1,64 @@
+﻿#include "GpuTimer.h"
+#include <algorithm>
+
+GpuTimer::GpuTimer(Context& context, const uint32_t scopeCount)
+    : context(context), recorded(scopeCount, false), milliseconds(scopeCount, -1.0f), beginMilliseconds(scopeCount, 0.0)
+{
+    const auto queueFamilies = context.getPhysicalDevice().getQueueFamilyProperties();
+    const uint32_t validBits = queueFamilies[context.getQueueFamilyIndices().front()].timestampValidBits;
+    supported = validBits > 0;
+    if (!supported)
+        return;
+
+    timestampPeriod = context.getPhysicalDevice().getProperties().limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    queryPool = context.getDevice().createQueryPoolUnique({{}, vk::QueryType::eTimestamp, scopeCount * 2});
+}
+
+void GpuTimer::reset(const vk::CommandBuffer commandBuffer) {
+    std::fill(recorded.begin(), recorded.end(), false);
+    if (supported)
+        commandBuffer.resetQueryPool(*queryPool, 0, static_cast<uint32_t>(recorded.size() * 2));
+}
+
+void GpuTimer::reset(const vk::CommandBuffer commandBuffer, const uint32_t scope) {
+    recorded[scope] = false;
+    if (supported)
+        commandBuffer.resetQueryPool(*queryPool, scope * 2, 2);
+}
+
+void GpuTimer::begin(const vk::CommandBuffer commandBuffer, const uint32_t scope) {
+    if (supported)
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *queryPool, scope * 2);
+}
+
+void GpuTimer::end(const vk::CommandBuffer commandBuffer, const uint32_t scope) {
+    if (!supported)
+        return;
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *queryPool, scope * 2 + 1);
+    recorded[scope] = true;
+}
+
+bool GpuTimer::collect() {
+    bool anyAvailable = false;
+    for (uint32_t scope = 0; scope < recorded.size(); ++scope)
+        anyAvailable = collect(scope) || anyAvailable;
+    return anyAvailable;
+}
+
+bool GpuTimer::collect(const uint32_t scope) {
+    milliseconds[scope] = -1.0f;
+    if (!recorded[scope])
+        return false;
+
+    // Begin and end timestamps, each followed by its availability
+    const auto [result, values] = context.getDevice().getQueryPoolResults<uint64_t>(*queryPool, scope * 2, 2, 4 * sizeof(uint64_t), 2 * sizeof(uint64_t),
+                                                                                  vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+    if (result != vk::Result::eSuccess || values[1] == 0 || values[3] == 0)
+        return false;
+
+    const uint64_t ticks = (values[2] - values[0]) & timestampMask;
+    milliseconds[scope] = static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-6);
+    beginMilliseconds[scope] = static_cast<double>(values[0] & timestampMask) * timestampPeriod * 1e-6;
+    return true;
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include "Context.h"
+#include <vector>
+
+// Timestamp queries around GPU work in one command buffer. Results are read back before the command buffer
+// is recorded again, once the fence of its previous submission signaled.
+class GpuTimer {
+public:
+    GpuTimer(Context& context, uint32_t scopeCount);
+
+    // Starts a new recording, call before the first scope of the command buffer
+    void reset(vk::CommandBuffer commandBuffer);
+    // Resets a single scope, for scopes that are recorded into different command buffers
+    void reset(vk::CommandBuffer commandBuffer, uint32_t scope);
+    void begin(vk::CommandBuffer commandBuffer, uint32_t scope);
+    void end(vk::CommandBuffer commandBuffer, uint32_t scope);
+
+    // Reads the scopes of the last recording, returns false if none of them is available
+    bool collect();
+    // Reads a single scope, returns false if it is not available
+    bool collect(uint32_t scope);
+    // Milliseconds of a scope in the collected recording, negative if it was not timed
+    float getMilliseconds(uint32_t scope) const { return milliseconds[scope]; }
+    // Start of a scope on the device timeline, comparable between timers on the same queue
+    double getBeginMilliseconds(uint32_t scope) const { return beginMilliseconds[scope]; }
+    bool isSupported() const { return supported; }
+
+private:
+    Context& context;
+    vk::UniqueQueryPool queryPool;
+    std::vector<bool> recorded; // Scopes written since the last reset, only these queries hold results
+    std::vector<float> milliseconds;
+    std::vector<double> beginMilliseconds;
+    float timestampPeriod = 1.0f; // Nanoseconds per tick
+    uint64_t timestampMask = ~0ull;
+    bool supported = false;
+};
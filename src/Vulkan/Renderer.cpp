@@ -3,8 +3,6 @@
 #include <vector>
 #include <algorithm>
 
-constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
-
 Renderer::Renderer(Context& context)
     : context(context)
 {
@@ -34,7 +32,10 @@ Renderer::Renderer(Context& context)
 
 // --- Destructor ---
 Renderer::~Renderer() {
-    context.getDevice().waitIdle();
+    {
+        auto queueLock = context.lockQueue();
+        context.getDevice().waitIdle();
+    }
     std::cout << "Destroying Renderer" << std::endl;
 }
 
@@ -89,7 +90,11 @@ void Renderer::createSwapChain() {
 }
 
 void Renderer::recreateSwapChain() {
-    context.getDevice().waitIdle();
+    {
+        // Waiting for idle synchronizes with the queue, a background import may be submitting
+        auto queueLock = context.lockQueue();
+        context.getDevice().waitIdle();
+    }
     createSwapChain();
     m_currentFrame = 0;
     computeSubmitted = false; 
@@ -154,6 +159,7 @@ bool Renderer::endFrame(bool waitForCompute) {
     // --- Use the semaphore corresponding to the acquired image index ---
     submitInfo.setSignalSemaphores(renderFinishedSemaphores[m_imageIndex].get());
 
+    auto queueLock = context.lockQueue();
     context.getQueue().submit(submitInfo, frames[m_currentFrame].inFlightFence.get());
 
     if (!swapchain)
@@ -192,7 +198,10 @@ void Renderer::submitCompute(const std::function<void(vk::CommandBuffer)>& recor
     submitInfo.setCommandBuffers(computeCommandBuffer.get());
     submitInfo.setSignalSemaphores(computeFinishedSemaphore.get());
 
-    context.getQueue().submit(submitInfo, computeFence.get());
+    {
+        auto queueLock = context.lockQueue();
+        context.getQueue().submit(submitInfo, computeFence.get());
+    }
     computeSubmitted = true;
 }
 
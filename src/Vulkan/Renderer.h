@@ -5,6 +5,8 @@
 
 class Renderer {
 public:
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
     Renderer(Context& context);
     ~Renderer();
 
@@ -23,6 +25,8 @@ public:
     // --- Getters ---
     const std::vector<vk::Image>& getSwapchainImages() const { return swapchainImages; }
     uint32_t getCurrentSwapchainImageIndex() const { return m_imageIndex; }
+    // Frame resource slot of the command buffer returned by beginFrame
+    uint32_t getCurrentFrameIndex() const { return m_currentFrame; }
 
 private:
     void createSwapChain();